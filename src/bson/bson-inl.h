@@ -81,8 +81,7 @@ namespace _bson {
         StringBuilder ss;
         int os = objsize();
         ss << "bsonobj size: " << os << " (0x" << integerToHex( os ) << ") is invalid. "
-           << "Size must be between 0 and " << BSONObjMaxInternalSize
-           << "(" << ( BSONObjMaxInternalSize/(1024*1024) ) << "MB)";
+           << "Size must be at least 5 bytes";
         try {
             bsonelement e = firstElement();
             ss << " First element: " << e.toString();
@@ -91,10 +90,12 @@ namespace _bson {
         massert( 10334 , ss.str() , 0 );
     }
     
-    /* add all the fields from the object specified to this object if they don't exist */
+    /* documents here are files rather than wire messages, so unlike the server we don't
+       cap them at BSONObjMaxInternalSize: anything the 32 bit size field can express goes.
+    */
     inline bool bsonobj::isValid() const {
         int x = objsize();
-        return x > 0 && x <= BSONObjMaxInternalSize;
+        return x >= 5;
     }
 
     inline bool bsonobj::getObjectID(bsonelement& e) const {
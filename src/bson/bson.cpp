@@ -1,6 +1,8 @@
 #include <string>
 #include "bsonobjbuilder.h"
 #include "bsonobjiterator.h"
+#include "fieldset.h"
+#include "nulscan.h"
 
 using namespace std;
 
@@ -25,15 +27,15 @@ namespace _bson {
             1,  // bool
             8,  // date
             0,  // null
-            0xff,  // regex,
-            0xff,  // dbref,
-            0xff,  // code,
-            0xff,  // symbol,
-            0xff,  // codewscope,
+            0xff,  // regex, two cstrings: see skipValue()
+            0x90,  // dbref, a string then a 12 byte oid
+            0x84,  // code,
+            0x84,  // symbol,
+            0x80,  // codewscope, the int32 counts the whole value
             4,  // int,
             8,  // timestamp,
             8,  // long = 18
-            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 32
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 31
             0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
             0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, //64
             0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -65,10 +67,14 @@ namespace _bson {
                 q(log() << "next will be:" << (p  1) << '\n' << endl;);
             }
             else {
-                if (z == 0xff) {
+                if (type == RegEx) {
+                    p += strlen(p) + 1;
+                    p += strlen(p) + 1;
+                }
+                else if (z == 0xff) {
                     q(log() << "backcompat" << endl;);
                     bsonelement e(elem);
-                    p += e.size();
+                    p = elem + e.size();
                 }
                 else {
                     int len = *((int *)p);
@@ -111,7 +117,7 @@ namespace _bson {
         return bsonobjiterator(s, e);
     }
 
-    inline int bsonelement::size() const {
+    int bsonelement::size() const {
         if (totalSize >= 0)
             return totalSize;
         int x = _valuesize();
@@ -187,51 +193,93 @@ namespace _bson {
 
     bsonelement bsonobj::getField(const StringData& name) const {
         const char *_name = name.begin();
-        unsigned name_sz = (unsigned)name.size();
+        size_t name_sz = name.size();
         q(log() << _name << ' ' << name_sz << endl;);
         const char *p = objdata();
         int sz = objsize();
         q(log() << sz << endl);
         const char *end = p + sz - 1;
         p += 4;
-        while (1) {
+        while (p < end) {
             const char *elem = p;
-            const char *nul = ++p + name_sz;
             q(log() << "type " << (int)*elem << endl;)
-                if (nul >= end) {
+            // the length of the name, found many bytes at a time, rules out most elements
+            // before their bytes are compared
+            const char *nul = iter::scanNul(elem + 1, end);
+            if (nul == end) {
                 q(log() << "end" << endl;)
-                    break;
+                break;
+            }
+            if ((size_t)(nul - elem - 1) == name_sz && memcmp(_name, elem + 1, name_sz) == 0) {
+                q(log() << "match!" << endl;)
+                return bsonelement((int)name_sz + 1, elem);
+            }
+            // else, mismatch.  skip the item's data
+            p = iter::skipValue(elem, nul + 1);
+        }
+        q(log() << "returning BSONElement() (mismatch)" << endl;)
+        return bsonelement();
+    }
+
+    namespace {
+        // the sets getFields() compiled last on this thread: callers mostly ask for the same
+        // names object after object, and compiling them is much slower than a scan
+        struct CompiledNames {
+            unsigned n;
+            FieldSet set;
+            CompiledNames() : n(0) {}
+        };
 
+        const FieldSet& compiledNames(unsigned n, const char **fieldNames) {
+            enum { Kept = 4 };
+            thread_local CompiledNames kept[Kept];
+            thread_local unsigned next = 0;
+            for (CompiledNames& c : kept) {
+                unsigned i = 0;
+                while (c.n == n && i < n && strcmp(c.set.name(i), fieldNames[i]) == 0) {
+                    i++;
                 }
-            if (*nul == 0) {
-                // potential match
-                q(log() << "memcmp check " << *p << endl;)
-                if (memcmp(_name, p, name_sz) == 0) {
-                    q(log() << "match!" << endl;)
-                    bsonelement e = bsonelement(name_sz + 1, elem);
-                    q(log() << e.toString() << endl;)
-                    return e;
+                if (c.n == n && i == n) {
+                    return c.set;
                 }
             }
-            // else, mismatch.  skip to next
-            q(log() << "skip ahead:" << p << endl;)
-                while (1) {
-                if ((*p++ == 0))   // both the loop unwinding here, and the use of 
-                    break;                          // unlikely(), made a measurable difference in a 
-                if ((*p++ == 0))   // quick ad hoc test (gcc 4.2.1)
-                    break;
+            CompiledNames& c = kept[next++ % Kept];
+            c.set = FieldSet(n, fieldNames);
+            c.n = n;
+            return c.set;
+        }
+    }
 
-                }
-            // skip the item's data
-            p = iter::skipValue(elem, p);
-            if (*p == 0) {
-                q(log() << "*p==EOO" << endl;)
+    void bsonobj::getFields(unsigned n, const char **fieldNames, bsonelement *fields) const {
+        // a few names are compared directly, more go through the hash of a FieldSet
+        if (n > 8) {
+            compiledNames(n, fieldNames).getFields(*this, fields);
+            return;
+        }
+        size_t lens[8];
+        bool found[8];
+        for (unsigned i = 0; i < n; i++) {
+            lens[i] = strlen(fieldNames[i]);
+            found[i] = false;
+        }
+        unsigned left = n;
+        const char *p = objdata() + 4;
+        const char *end = objdata() + objsize() - 1;
+        while (left && p < end) {
+            const char *nul = iter::scanNul(p + 1, end);
+            if (nul == end) {
                 break;
             }
-
+            size_t len = nul - (p + 1);
+            for (unsigned i = 0; i < n; i++) {
+                if (!found[i] && lens[i] == len && memcmp(fieldNames[i], p + 1, len) == 0) {
+                    fields[i] = bsonelement(p, (int)len + 1, bsonelement::FieldNameSizeTag());
+                    found[i] = true;
+                    left--;
+                }
+            }
+            p = iter::skipValue(p, p + len + 2);
         }
-        q(log() << "returning BSONElement() (mismatch)" << endl;)
-        return bsonelement();
     }
 
     const string bsonobjbuilder::numStrs[] = {
@@ -682,6 +730,16 @@ namespace _bson {
         return -1;
     }
 
+	int bsonobj::nFields() const {
+		int n = 0;
+		bsonobjiterator i(*this);
+		while (i.more()) {
+			i.next();
+			n++;
+		}
+		return n;
+	}
+
 	void bsonobj::elems(std::vector<bsonelement>& v) const {
 		bsonobjiterator i(*this);
 		while (i.more()) {
@@ -0,0 +1,172 @@
+// bson_validate.cpp
+
+#include <cstring>
+#include "bson_validate.h"
+#include "bsonobj.h"
+#include "endian.h"
+
+namespace _bson {
+
+    namespace iter {
+        extern unsigned char sizeForBsonType[];
+    }
+
+    namespace {
+
+        inline Status invalid(const char* what) {
+            return Status(InvalidBSON, what);
+        }
+
+        // a string value at p: int32 size (terminator included), bytes, NUL. room is what is
+        // left before the EOO of the enclosing object. returns its end, or 0
+        inline const char* skipString(const char* p, long long room) {
+            if (room < 5) {
+                return 0;
+            }
+            int len = readInt(p);
+            if (len < 1 || len > room - 4 || p[4 + len - 1] != 0) {
+                return 0;
+            }
+            return p + 4 + len;
+        }
+
+        // a NUL terminated string at p, within room bytes. returns its end, or 0
+        inline const char* skipCString(const char* p, long long room) {
+            if (room <= 0) {
+                return 0;
+            }
+            const char* nul = (const char*)memchr(p, 0, (size_t)room);
+            return nul ? nul + 1 : 0;
+        }
+
+    }
+
+    /* one pass over the buffer with an explicit stack of where the enclosing objects end.
+       the invariant is that p < end whenever a type byte is read: every element is checked to
+       end before the last byte of its object, which must be the EOO.
+    */
+    Status validateBSON(const char* buf, uint64_t maxLength) {
+        if (!buf || maxLength < 5) {
+            return invalid("buffer too small to hold a BSON object");
+        }
+        int size = readInt(buf);
+        if (size < 5 || (uint64_t)size > maxLength) {
+            return invalid("object size out of bounds");
+        }
+        const char* ends[BSONMaxDepth];
+        int depth = 0;
+        const char* end = buf + size;
+        const char* p = buf + 4;
+        while (true) {
+            unsigned char type = (unsigned char)*p++;
+            if (type == EOO) {
+                if (p != end) {
+                    return invalid("EOO before the end of an object");
+                }
+                if (depth == 0) {
+                    return Status::OK();
+                }
+                end = ends[--depth];
+                continue;
+            }
+            // the field name, then the value must fit before the EOO at end - 1
+            p = skipCString(p, (end - 1) - p);
+            if (!p) {
+                return invalid("unterminated field name");
+            }
+            long long room = (end - 1) - p;
+            unsigned z = iter::sizeForBsonType[type];
+            if (z < 0x80) {
+                if ((long long)z > room) {
+                    return invalid("value past the end of its object");
+                }
+                if (type == Bool && (unsigned char)*p > 1) {
+                    return invalid("bool that is neither 0 nor 1");
+                }
+                p += z;
+                continue;
+            }
+            if (z != 0xff) {
+                if (room < 4) {
+                    return invalid("value past the end of its object");
+                }
+                int len = readInt(p);
+                switch (type) {
+                case String:
+                case Code:
+                case Symbol:
+                    p = skipString(p, room);
+                    if (!p) {
+                        return invalid("bad string");
+                    }
+                    break;
+                case Object:
+                case Array:
+                    if (len < 5 || len > room) {
+                        return invalid("object size out of bounds");
+                    }
+                    if (depth == BSONMaxDepth) {
+                        return invalid("objects nested too deep");
+                    }
+                    ends[depth++] = end;
+                    end = p + len;
+                    p += 4;
+                    break;
+                case BinData:
+                    if (len < 0 || len > room - 5) {
+                        return invalid("binary data size out of bounds");
+                    }
+                    // the old binary subtype repeats the size inside the data
+                    if (p[4] == ByteArrayDeprecated && (len < 4 || readInt(p + 5) != len - 4)) {
+                        return invalid("bad size of old binary data");
+                    }
+                    p += 5 + len;
+                    break;
+                case DBRef:
+                    p = skipString(p, room);
+                    if (!p || (end - 1) - p < 12) {
+                        return invalid("bad DBRef");
+                    }
+                    p += 12;
+                    break;
+                case CodeWScope:
+                {
+                    // int32 total size, the code as a string, then the scope as an object
+                    int total = len;
+                    if (total < 4 + 5 + 5 || total > room) {
+                        return invalid("bad code with scope");
+                    }
+                    const char* scope = skipString(p + 4, total - 4);
+                    if (!scope || (p + total) - scope < 5 || readInt(scope) != (p + total) - scope) {
+                        return invalid("bad code with scope");
+                    }
+                    if (depth == BSONMaxDepth) {
+                        return invalid("objects nested too deep");
+                    }
+                    ends[depth++] = end;
+                    end = p + total;
+                    p = scope + 4;
+                    break;
+                }
+                default:
+                    return invalid("unknown element type");
+                }
+                continue;
+            }
+            if (type != RegEx) {
+                return invalid("unknown element type");
+            }
+            // the only type whose size isn't in the table: two cstrings
+            p = skipCString(p, room);
+            p = p ? skipCString(p, (end - 1) - p) : 0;
+            if (!p) {
+                return invalid("bad regular expression");
+            }
+        }
+    }
+
+    bool bsonobj::valid() const {
+        return validateBSON(objdata(), objsize()).isOK();
+    }
+
+}
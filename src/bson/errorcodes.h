@@ -7,7 +7,8 @@ namespace _bson {
 enum ErrorCodes {
     Ok = 0,
     BadValue = 2,
-    FailedToParse = 9
+    FailedToParse = 9,
+    InvalidBSON = 22
     };
 
 }
@@ -0,0 +1,135 @@
+// fieldset.cpp
+
+#include <cstring>
+#include "fieldset.h"
+#include "nulscan.h"
+
+namespace _bson {
+
+    namespace iter {
+        const char * skipValue(const char *elem, const char *valueStart);
+    }
+
+    namespace {
+        // tried per table size before the table is doubled
+        const int SeedsPerSize = 64;
+    }
+
+    FieldSet::FieldSet(unsigned n, const char **fieldNames) : _seed(0), _mask(0), _lengths(0) {
+        for (unsigned i = 0; i < n; i++) {
+            size_t len = strlen(fieldNames[i]);
+            _names.push_back(Name{ _text.size(), len, -1 });
+            _text.append(fieldNames[i], len + 1);
+        }
+        compile();
+    }
+
+    FieldSet::FieldSet(const std::vector<std::string>& fieldNames) : _seed(0), _mask(0), _lengths(0) {
+        for (const std::string& s : fieldNames) {
+            _names.push_back(Name{ _text.size(), s.size(), -1 });
+            _text.append(s.c_str(), s.size() + 1);
+        }
+        compile();
+    }
+
+    void FieldSet::compile() {
+        for (const Name& n : _names) {
+            _lengths |= lengthBit(n.len);
+        }
+        if (_names.empty()) {
+            return;
+        }
+        // look for a seed that sends every different name to its own slot, in a table at least
+        // four times as large as the set, and double the table when a few of them fail. a name
+        // landing on its own repeat is chained behind it
+        size_t size = 4;
+        while (size < _names.size() * 4) {
+            size <<= 1;
+        }
+        std::vector<int> tails;
+        for (;; size <<= 1) {
+            _mask = (uint32_t)(size - 1);
+            for (int attempt = 0; attempt < SeedsPerSize; attempt++) {
+                _seed = (uint32_t)(size * SeedsPerSize + attempt);
+                _slots.assign(size, -1);
+                tails.assign(size, -1);
+                _distinct.clear();
+                bool perfect = true;
+                for (int i = 0; i < (int)_names.size() && perfect; i++) {
+                    _names[i].next = -1;
+                    uint32_t slot = slotFor(name(i), _names[i].len);
+                    int first = _slots[slot];
+                    if (first < 0) {
+                        _slots[slot] = tails[slot] = i;
+                        _distinct.push_back(i);
+                    } else if (_names[first].len == _names[i].len && memcmp(name(first), name(i), _names[i].len) == 0) {
+                        _names[tails[slot]].next = i;
+                        tails[slot] = i;
+                    } else {
+                        perfect = false;
+                    }
+                }
+                if (perfect) {
+                    return;
+                }
+            }
+        }
+    }
+
+    uint32_t FieldSet::slotFor(const char* p, size_t len) const {
+        uint32_t h = (2166136261u ^ _seed * 2654435761u) + (uint32_t)len;
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ (unsigned char)p[i]) * 16777619u;
+        }
+        h ^= h >> 15;
+        return h & _mask;
+    }
+
+    int FieldSet::find(const char* p, size_t len) const {
+        if (!(_lengths & lengthBit(len)) || _slots.empty()) {
+            return -1;
+        }
+        int i = _slots[slotFor(p, len)];
+        return i >= 0 && _names[i].len == len && memcmp(name(i), p, len) == 0 ? i : -1;
+    }
+
+    unsigned FieldSet::getFields(const bsonobj& obj, bsonelement *fields) const {
+        unsigned set = 0;
+        size_t left = _distinct.size();
+        if (!left) {
+            return 0;
+        }
+        // which names were already met, as only the first element of a name counts
+        bool few = _names.size() <= 64;
+        uint64_t seenBits = 0;
+        std::vector<char> seen(few ? 0 : _names.size());
+        const char *p = obj.objdata() + 4;
+        const char *end = obj.objdata() + obj.objsize() - 1;
+        while (p < end) {
+            const char *nul = iter::scanNul(p + 1, end);
+            if (nul == end) {
+                break;
+            }
+            size_t len = nul - (p + 1);
+            int i = find(p + 1, len);
+            if (i >= 0 && !(few ? seenBits >> i & 1 : seen[i])) {
+                bsonelement e(p, (int)len + 1, bsonelement::FieldNameSizeTag());
+                if (few) {
+                    seenBits |= 1ull << i;
+                } else {
+                    seen[i] = 1;
+                }
+                for (int k = i; k >= 0; k = _names[k].next) {
+                    fields[k] = e;
+                    set++;
+                }
+                if (--left == 0) {
+                    break;
+                }
+            }
+            p = iter::skipValue(p, p + len + 2);
+        }
+        return set;
+    }
+
+}
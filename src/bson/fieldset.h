@@ -0,0 +1,59 @@
+// fieldset.h
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bsonobj.h"
+
+namespace _bson {
+
+    /** a set of field names compiled once to be fetched from many objects, e.g. the fields of
+        each record of a collection.
+
+        getFields() walks an object once and checks each element name against the whole set:
+        names of a length no name in the set has are dropped from a bit mask, the others go
+        through a perfect hash of the set, chosen when it is built, and one comparison. so
+        pulling 10 or 20 fields out of a document costs one scan instead of one per field.
+    */
+    class FieldSet {
+    public:
+        FieldSet() : _seed(0), _mask(0), _lengths(0) {}
+        FieldSet(unsigned n, const char **fieldNames);
+        explicit FieldSet(const std::vector<std::string>& fieldNames);
+
+        /** number of names, repeats included */
+        unsigned size() const { return (unsigned)_names.size(); }
+        const char* name(unsigned i) const { return _text.c_str() + _names[i].offset; }
+
+        /** @return the position of the first name equal to the len bytes at name, or -1 */
+        int find(const char* name, size_t len) const;
+
+        /** same as bsonobj::getFields() with the names of the set: fields[i] is set to the
+            first element named name(i), and left unchanged if there is none.
+            @return the number of positions set
+        */
+        unsigned getFields(const bsonobj& obj, bsonelement *fields) const;
+
+    private:
+        struct Name {
+            size_t offset;
+            size_t len;
+            int next; // next position with the same name, or -1
+        };
+
+        void compile();
+        uint32_t slotFor(const char* p, size_t len) const;
+        static uint64_t lengthBit(size_t len) { return 1ull << (len < 63 ? len : 63); }
+
+        std::string _text;          // the names, each with its NUL
+        std::vector<Name> _names;
+        std::vector<int> _slots;    // first position of the name hashed there, or -1
+        std::vector<int> _distinct; // first position of each different name
+        uint32_t _seed;
+        uint32_t _mask;
+        uint64_t _lengths;
+    };
+
+}
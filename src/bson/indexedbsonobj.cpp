@@ -0,0 +1,99 @@
+// indexedbsonobj.cpp
+
+#include <cstring>
+#include "indexedbsonobj.h"
+#include "bsonobjiterator.h"
+
+namespace _bson {
+
+    namespace {
+
+        // fnv-1a over the bytes of a field name
+        inline uint32_t hashName(const char* p, size_t n) {
+            uint32_t h = 2166136261u;
+            for (size_t i = 0; i < n; i++) {
+                h = (h ^ (unsigned char)p[i]) * 16777619u;
+            }
+            return h;
+        }
+
+        // whether the element at elem is named name, which is n bytes long. a longer name
+        // than the element's could run past the EOO at end
+        inline bool named(const char* elem, const char* end, const char* name, size_t n) {
+            return (size_t)(end - elem) > 1 + n && elem[1 + n] == 0 && memcmp(elem + 1, name, n) == 0;
+        }
+
+    }
+
+    void indexedbsonobj::buildIndex() const {
+        if (_built) {
+            return;
+        }
+        _built = true;
+        const char* base = _obj.objdata();
+        const char* end = base + _obj.objsize() - 1;
+        std::vector<uint32_t> offsets;
+        bsonobjiterator it(_obj);
+        while (it.more()) {
+            offsets.push_back((uint32_t)(it.next().rawdata() - base));
+        }
+        if (offsets.size() < MinIndexedFields) {
+            return;
+        }
+        size_t slots = 1;
+        while (slots < offsets.size() * 2) {
+            slots <<= 1;
+        }
+        _slots.assign(slots, 0);
+        size_t mask = slots - 1;
+        for (size_t k = 0; k < offsets.size(); k++) {
+            const char* elem = base + offsets[k];
+            const char* name = elem + 1;
+            size_t n = strlen(name);
+            size_t i = hashName(name, n) & mask;
+            // a repeated name keeps its first element, as getField() finds
+            while (_slots[i] && !named(base + _slots[i], end, name, n)) {
+                i = (i + 1) & mask;
+            }
+            if (!_slots[i]) {
+                _slots[i] = offsets[k];
+            }
+        }
+    }
+
+    bsonelement indexedbsonobj::getField(const StringData& name) const {
+        buildIndex();
+        if (_slots.empty()) {
+            return _obj.getField(name);
+        }
+        const char* base = _obj.objdata();
+        const char* end = base + _obj.objsize() - 1;
+        size_t n = name.size();
+        size_t mask = _slots.size() - 1;
+        for (size_t i = hashName(name.rawData(), n) & mask; _slots[i]; i = (i + 1) & mask) {
+            const char* elem = base + _slots[i];
+            if (named(elem, end, name.rawData(), n)) {
+                return bsonelement(elem, (int)n + 1, bsonelement::FieldNameSizeTag());
+            }
+        }
+        return bsonelement();
+    }
+
+    bsonelement indexedbsonobj::getFieldDotted(const StringData& name) const {
+        bsonelement e = getField(name);
+        if (e.eoo()) {
+            size_t dot_offset = name.find('.');
+            if (dot_offset != std::string::npos) {
+                bsonelement left = getField(name.substr(0, dot_offset));
+                BSONType t = left.type();
+                if (t != Object && t != Array) {
+                    return bsonelement();
+                }
+                bsonobj sub = left.object();
+                return sub.isEmpty() ? bsonelement() : sub.getFieldDotted(name.substr(dot_offset + 1));
+            }
+        }
+        return e;
+    }
+
+}
@@ -0,0 +1,60 @@
+// indexedbsonobj.h
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "bsonobj.h"
+
+namespace _bson {
+
+    /** a bsonobj with an index of its top level field names, for objects that are looked up
+        many times or that have many fields.
+
+        bsonobj::getField() walks the elements one by one, so every lookup is O(n). the first
+        lookup here builds a hash table from field name to element offset and every following
+        one is answered from it in O(1). the table is one 32 bit offset per slot, kept at
+        most half full, and the names are compared in place, so nothing is copied out of the
+        object. objects with fewer than MinIndexedFields fields are not indexed: scanning them
+        is as fast.
+
+        like bsonobj this doesn't own the bytes, which must stay alive and unchanged while it
+        is used. the index is built from const lookups, so an indexedbsonobj must not be read
+        from several threads at once unless buildIndex() was called first.
+    */
+    class indexedbsonobj {
+    public:
+        enum { MinIndexedFields = 16 };
+
+        indexedbsonobj() : _built(false) {}
+        explicit indexedbsonobj(const bsonobj& obj) : _obj(obj), _built(false) {}
+
+        const bsonobj& obj() const { return _obj; }
+
+        /** builds the index now instead of on the first lookup. does nothing if built */
+        void buildIndex() const;
+
+        /** @return whether lookups go through a hash table (false until the first lookup,
+            and for small objects) */
+        bool indexed() const { return !_slots.empty(); }
+
+        /** same as bsonobj::getField(): the first field of that name, eoo() if none */
+        bsonelement getField(const StringData& name) const;
+
+        bsonelement operator[] (const StringData& name) const { return getField(name); }
+
+        /** @return true if field exists */
+        bool hasField(const StringData& name) const { return !getField(name).eoo(); }
+
+        /** same as bsonobj::getFieldDotted(). only the first part of the name goes through
+            the index; the embedded objects are scanned as usual */
+        bsonelement getFieldDotted(const StringData& name) const;
+
+    private:
+        bsonobj _obj;
+        // offset of the element from objdata(), 0 for an empty slot
+        mutable std::vector<uint32_t> _slots;
+        mutable bool _built;
+    };
+
+}
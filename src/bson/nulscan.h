@@ -0,0 +1,65 @@
+// nulscan.h
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BSON_NULSCAN_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace _bson {
+
+    namespace iter {
+
+        inline unsigned lowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+            unsigned long i;
+            _BitScanForward(&i, mask);
+            return (unsigned)i;
+#else
+            return (unsigned)__builtin_ctz(mask);
+#endif
+        }
+
+        /** finds the NUL ending the string at p, e.g. a field name, reading no byte at or past
+            end: 32 bytes at a time with AVX2, 16 with SSE2, then one by one.
+            @return the NUL, or end if there is none before it
+        */
+        inline const char* scanNul(const char* p, const char* end) {
+#if defined(__AVX2__)
+            const __m256i zero32 = _mm256_setzero_si256();
+            for (; end - p >= 32; p += 32) {
+                uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), zero32));
+                if (mask) {
+                    return p + lowestBit(mask);
+                }
+            }
+#endif
+#if defined(BSON_NULSCAN_SSE2)
+            const __m128i zero16 = _mm_setzero_si128();
+            for (; end - p >= 16; p += 16) {
+                uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero16));
+                if (mask) {
+                    return p + lowestBit(mask);
+                }
+            }
+#endif
+            for (; p < end; p++) {
+                if (*p == 0) {
+                    return p;
+                }
+            }
+            return end;
+        }
+
+    }
+
+}
@@ -1,5 +1,6 @@
 #pragma once 
 
+#include <ctime>
 #include "status_with.h"
 #include "cstdint.h"
 #include "string_data.h"
@@ -1,7 +1,8 @@
 #include "ofxBson.h"
-#include <boost/uuid/uuid.hpp>
-#include <boost/uuid/uuid_io.hpp>
-#include <boost/lexical_cast.hpp>
+#include "bson/bsonobjiterator.h"
+#include "bson/bson_validate.h"
+#include "ofxBsonMappedFile.h"
+#include "ofxBsonThreadPool.h"
 
 using namespace _bson;
 
@@ -67,323 +68,2692 @@ void ofxBson::deserialize(ofAbstractParameter & parameter) {
 	}
 }
 
+ofxBson::ofxBson(const ofxBson& from, const shared_ptr<BSONNode>& root) :
+	async(make_shared<AsyncState>()), pendingLoads(0),
+	constructors(from.constructors), storedObjects(from.storedObjects), store(0),
+	useArena(false), arenaBlockSize(ofxBsonArena::DefaultBlockSize), lazyLoad(false), incrementalSave(false),
+	parallelSave(false), saveThreads(0),
+	doc(make_shared<BSONDocument>(from.doc->keys)), readOnly(true) {
+	// a document of its own, for the paths resolved on the view; the tree stays frozen
+	doc->objectsScanned = from.doc->objectsScanned;
+	// the objects loaded but not stored yet: the view stores them itself when it looks one up
+	doc->loadedObjects = from.doc->loadedObjects;
+	setRoot(root);
+}
+
+ofxBson::~ofxBson() {
+	if (pendingLoads > 0) {
+		ofRemoveListener(ofEvents().update, this, &ofxBson::onUpdate);
+	}
+}
+
+shared_ptr<ofxBson::BSONDocument> ofxBson::newDocument() const {
+	auto d = make_shared<BSONDocument>(useArena, arenaBlockSize);
+	d->cacheSerialized = incrementalSave;
+	return d;
+}
+
+shared_ptr<ofxBson::BSONObjNode> ofxBson::parseRoot(ofxBson* bson, const bsonobj & obj, const shared_ptr<const void>& backing, const shared_ptr<BSONDocument>& d, bool lazy) {
+	auto node = makeNode<BSONObjNode>(d, weak_ptr<BSONNode>(), bson, d);
+	if (lazy) {
+		node->setLazy(obj, backing);
+	} else {
+		node->loadFrom(obj);
+	}
+	return node;
+}
+
+void ofxBson::loadRoot(const bsonobj & obj, const shared_ptr<const void>& backing) {
+	doc = newDocument();
+	storedObjects = make_shared<ObjectStore>();
+	setRoot(parseRoot(this, obj, backing, doc, lazyLoad));
+}
+
 bool ofxBson::load(const string & path) {
 	ofFile loaded;
 	if (loaded.open(path, ofFile::ReadOnly, true)) {
-		ofBuffer buf = loaded.readToBuffer();
-		bsonobj obj(buf.getData());
-		current = root = make_shared<BSONObjNode>(obj);
+		auto buf = make_shared<ofBuffer>(loaded.readToBuffer());
 		loaded.close();
+		// a file may be truncated or not bson at all: checked like bytes from memory
+		if (!validateBSON(buf->getData(), buf->size()).isOK()) {
+			return false;
+		}
+		loadRoot(bsonobj(buf->getData()), buf);
+		return true;
+	}
+	return false;
+}
+
+bool ofxBson::loadFromBuffer(const char * data, size_t size, Ownership ownership) {
+	shared_ptr<const void> backing;
+	switch (ownership) {
+	case CopyBuffer:
+	{
+		auto buf = make_shared<ofBuffer>(data, size);
+		data = buf->getData();
+		backing = buf;
+		break;
+	}
+	case BorrowBuffer:
+		// nothing to release: only keeps the nodes that read from it in lazy mode going
+		backing = shared_ptr<const void>(data, [](const void*) {});
+		break;
+	case AdoptBuffer:
+		backing = shared_ptr<const void>(data, [](const void* p) { delete[] (const char*)p; });
+		break;
+	}
+	// bytes from memory usually come from elsewhere: they are checked through before anything reads them
+	if (!validateBSON(data, size).isOK()) {
+		return false;
+	}
+	loadRoot(bsonobj(data), backing);
+	return true;
+}
+
+bool ofxBson::loadMapped(const string & path) {
+	auto mapped = make_shared<ofxBsonMappedFile>();
+	if (!mapped->open(ofToDataPath(path, true))) {
+		return false;
+	}
+	if (mapped->size() < 5) {
+		return false;
+	}
+	bsonobj obj(mapped->getData());
+	if (obj.objsize() < 5 || (size_t)obj.objsize() > mapped->size()) {
+		return false;
+	}
+	// the tree is about to read every page anyway. a lazy document doesn't validate: that
+	// would read the whole file before the first field, which mapping it lazily is meant to avoid
+	if (!lazyLoad && !validateBSON(mapped->getData(), mapped->size()).isOK()) {
+		return false;
+	}
+	loadRoot(obj, mapped);
+	return true;
+}
+
+std::future<bool> ofxBson::loadAsync(const string & path) {
+	auto pending = make_shared<AsyncLoad>();
+	auto result = pending->done.get_future();
+	// everything the worker needs is set up here; it never touches the current tree
+	pending->doc = newDocument();
+	string fullPath = ofToDataPath(path, true);
+	bool lazy = lazyLoad;
+	auto state = async;
+	if (pendingLoads++ == 0) {
+		ofAddListener(ofEvents().update, this, &ofxBson::onUpdate);
+	}
+	ofxBson* bson = this;
+	runAsync(state, [bson, pending, fullPath, lazy, state]() {
+		try {
+			ofFile loaded;
+			if (!loaded.open(fullPath, ofFile::ReadOnly, true)) {
+				throw runtime_error("can't open " + fullPath);
+			}
+			auto buf = make_shared<ofBuffer>(loaded.readToBuffer());
+			loaded.close();
+			if (!validateBSON(buf->getData(), buf->size()).isOK()) {
+				throw runtime_error("not a bson document");
+			}
+			bsonobj obj(buf->getData());
+			// the nodes only store the ofxBson pointer, so building the tree here is safe
+			pending->root = parseRoot(bson, obj, buf, pending->doc, lazy);
+		} catch (...) {
+			pending->root.reset();
+		}
+		lock_guard<mutex> guard(state->lock);
+		state->finished.push_back(pending);
+	});
+	return result;
+}
+
+void ofxBson::runAsync(const shared_ptr<AsyncState>& state, function<void()> job) {
+	lock_guard<mutex> guard(state->lock);
+	state->jobs.push_back(move(job));
+	if (state->working) {
+		return;
+	}
+	state->working = true;
+	thread([state]() {
+		for (;;) {
+			function<void()> next;
+			{
+				lock_guard<mutex> guard(state->lock);
+				if (state->jobs.empty()) {
+					state->working = false;
+					return;
+				}
+				next = move(state->jobs.front());
+				state->jobs.pop_front();
+			}
+			next();
+		}
+	}).detach();
+}
+
+void ofxBson::applyAsyncLoads() {
+	deque<shared_ptr<AsyncLoad>> finished;
+	{
+		lock_guard<mutex> guard(async->lock);
+		finished.swap(async->finished);
+	}
+	for (auto& pending : finished) {
+		if (pending->root) {
+			shared_ptr<BSONDocument> oldDoc = doc;
+			shared_ptr<BSONNode> oldRoot = root;
+			shared_ptr<ObjectStore> oldStore = storedObjects;
+			doc = pending->doc;
+			storedObjects = make_shared<ObjectStore>();
+			setRoot(pending->root);
+			// the old tree may take long to free: the job holding the last references to it
+			// is destroyed by the worker, once it ran
+			function<void()> release = [oldDoc, oldRoot, oldStore]() {};
+			oldDoc.reset();
+			oldRoot.reset();
+			oldStore.reset();
+			runAsync(async, move(release));
+		}
+		pending->done.set_value(!!pending->root);
+		if (--pendingLoads == 0) {
+			ofRemoveListener(ofEvents().update, this, &ofxBson::onUpdate);
+		}
+	}
+}
+
+void ofxBson::onUpdate(ofEventArgs &) {
+	applyAsyncLoads();
+}
+
+std::future<bool> ofxBson::saveAsync(const string & path) {
+	auto view = snapshot();
+	view->incrementalSave = incrementalSave;
+	view->doc->cacheSerialized = incrementalSave;
+	view->parallelSave = parallelSave;
+	view->saveThreads = saveThreads;
+	if (parallelSave) {
+		// kept from one save to the next; only the worker uses it
+		if (!async->pool || async->poolThreads != saveThreads) {
+			async->pool = make_shared<ofxBsonThreadPool>(saveThreads);
+			async->poolThreads = saveThreads;
+		}
+		view->savePool = async->pool;
+	}
+	string fullPath = ofToDataPath(path, true);
+	auto done = make_shared<promise<bool>>();
+	auto result = done->get_future();
+	runAsync(async, [view, fullPath, done]() {
+		bool ok = false;
+		try {
+			ok = view->save(fullPath);
+		} catch (...) {
+			ok = false;
+		}
+		done->set_value(ok);
+	});
+	return result;
+}
+
+bool ofxBson::save(const string & path) {
+	if (incrementalSave) {
+		return saveIncremental(path);
+	}
+	if (parallelSave) {
+		return saveParallel(path);
+	}
+	ofxBsonStreamWriter w;
+	if (!w.open(ofToDataPath(path, true))) {
+		return false;
+	}
+	w.start();
+	root->getObject()->constructInStream(w);
+	return w.close();
+}
+
+// a document built in memory goes through the stream writer too, so it replaces the file in one step
+static bool writeFile(const string & fullPath, const bsonobj & o) {
+	ofxBsonStreamWriter w;
+	if (!w.open(fullPath)) {
+		return false;
+	}
+	w.start();
+	w.appendElements(o);
+	w.done();
+	return w.close();
+}
+
+bool ofxBson::saveIncremental(const string & path) {
+	bsonobj o;
+	shared_ptr<const void> buf;
+	if (!saveCached(o, buf)) {
+		return false;
+	}
+	return writeFile(ofToDataPath(path, true), o);
+}
+
+shared_ptr<ofxBson> ofxBson::snapshot() {
+	freeze();
+	// the store and constructors are shared, not copied: whichever side changes them first copies them
+	return shared_ptr<ofxBson>(new ofxBson(*this, root));
+}
+
+void ofxBson::freeze() {
+	auto live = make_shared<BSONDocument>(doc->keys);
+	live->keys->share();
+	// the frozen document only makes nodes for reading from now on, maybe on other threads
+	live->arena = doc->arena;
+	doc->arena.reset();
+	live->cacheSerialized = doc->cacheSerialized;
+	live->objectsScanned = doc->objectsScanned;
+	// a frozen document registers nothing anymore: the new one takes over what is left to store
+	live->loadedObjects.swap(doc->loadedObjects);
+	doc->frozen = true;
+	doc = live;
+}
+
+void ofxBson::setRoot(const shared_ptr<BSONNode>& node) {
+	current = root = node;
+	Level top;
+	top.node = node;
+	top.index = string::npos;
+	levels.assign(1, top);
+}
+
+void ofxBson::descend(const shared_ptr<BSONNode>& node, const string & name, size_t index) {
+	Level next;
+	next.node = node;
+	next.name = name;
+	next.index = index;
+	levels.push_back(next);
+	current = node;
+}
+
+bool ofxBson::descendReference(const shared_ptr<BSONNode>& ref, const string & name, size_t index) {
+	ofxBsonUUID guid = ref->getUUID();
+	auto obj = findObject(guid);
+	if (!obj) {
+		return false;
+	}
+	descend(obj, name, index);
+	levels.back().reference = true;
+	levels.back().guid = guid;
+	return true;
+}
+
+bool ofxBson::own() {
+	if (readOnly) {
+		return false;
+	}
+	if (!own(levels)) {
+		return false;
+	}
+	current = levels.back().node;
+	return true;
+}
+
+bool ofxBson::own(vector<Level>& path) {
+	size_t i = 0;
+	while (i < path.size() && !path[i].node->isShared()) {
+		i++;
+	}
+	for (; i < path.size(); i++) {
+		Level& at = path[i];
+		if (i == 0) {
+			at.node = root;
+		} else if (at.reference) {
+			// the object lives elsewhere in the tree: it is copied there, along with the
+			// nodes above it, which may include the levels above this one
+			if (!ownObject(at.guid)) {
+				return false;
+			}
+			for (size_t j = 0; j <= i; j++) {
+				if (!refetch(path, j)) {
+					return false;
+				}
+			}
+			continue;
+		} else if (!refetch(path, i)) {
+			return false;
+		}
+		if (!at.node->isShared()) {
+			continue;
+		}
+		shared_ptr<BSONNode> copy;
+		weak_ptr<BSONNode> parent = i > 0 ? path[i - 1].node : shared_ptr<BSONNode>();
+		if (at.node->isArray()) {
+			copy = at.node->getArray()->copy(parent, doc);
+		} else {
+			copy = at.node->getObject()->copy(parent, doc);
+		}
+		if (i == 0) {
+			root = copy;
+		} else if (path[i - 1].node->isArray()) {
+			path[i - 1].node->getArray()->replaceAt(at.index, copy);
+		} else {
+			path[i - 1].node->getObject()->replaceChild(at.name, copy);
+		}
+		// the store follows its objects to their copies
+		if (auto obj = dynamic_pointer_cast<BSONObjWithGUIDNode>(copy)) {
+			auto stored = storedObjects->find(obj->guid);
+			if (stored && *stored == at.node) {
+				storeForWriting()[obj->guid] = obj;
+			}
+		}
+		at.node = copy;
+	}
+	return true;
+}
+
+bool ofxBson::refetch(vector<Level>& path, size_t i) {
+	Level& at = path[i];
+	if (i == 0) {
+		at.node = root;
+	} else if (at.reference) {
+		at.node = findObject(at.guid);
+	} else {
+		// the parent may be a copy by now: take the child it holds now
+		auto& parent = path[i - 1].node;
+		if (parent->isArray()) {
+			at.node = parent->getArray()->getAt(at.index);
+		} else {
+			at.node = parent->getObject()->getChild(at.name);
+		}
+	}
+	return !!at.node;
+}
+
+bool ofxBson::ownObject(const ofxBsonUUID & guid) {
+	auto obj = findObject(guid);
+	if (!obj) {
+		return false;
+	}
+	if (!obj->isShared()) {
+		return true;
+	}
+	vector<Level> steps;
+	if (!root->pathTo(obj.get(), steps)) {
+		// not in the tree anymore, only stored: a copy of its own does
+		storeForWriting()[guid] = static_pointer_cast<BSONObjWithGUIDNode>(obj->copy(weak_ptr<BSONNode>(), doc));
+		return true;
+	}
+	vector<Level> path(1);
+	path[0].node = root;
+	path.insert(path.end(), steps.rbegin(), steps.rend());
+	return own(path);
+}
+
+ofxBson::ObjectStore& ofxBson::storeForWriting() {
+	// only this ofxBson hands the store out, so nothing can start sharing it meanwhile
+	if (storedObjects.use_count() > 1) {
+		storedObjects = make_shared<ObjectStore>(*storedObjects);
+	}
+	return *storedObjects;
+}
+
+void ofxBson::storeLoaded() {
+	if (doc->loadedObjects.empty()) {
+		return;
+	}
+	auto& objects = storeForWriting();
+	for (auto& loaded : doc->loadedObjects) {
+		if (auto obj = loaded.lock()) {
+			objects[obj->guid] = obj;
+		}
+	}
+	doc->loadedObjects.clear();
+}
+
+void ofxBson::storeAll() {
+	storeLoaded();
+	if (!doc->objectsScanned && root) {
+		// objects inside containers that are still lazy have no node yet
+		doc->objectsScanned = true;
+		root->loadObjects();
+		// the shared ones are left as they are: copies of them are read in instead
+		vector<Level> at;
+		vector<vector<Level>> holders;
+		root->sharedObjectHolders(at, holders);
+		for (auto& steps : holders) {
+			vector<Level> path(1);
+			path[0].node = root;
+			path.insert(path.end(), steps.begin(), steps.end());
+			if (own(path)) {
+				path.back().node->loadObjects();
+			}
+		}
+		storeLoaded();
+	}
+}
+
+shared_ptr<ofxBson::BSONObjWithGUIDNode> ofxBson::findObject(const ofxBsonUUID & guid) {
+	if (store) {
+		// a view of constructAll(), maybe on a worker: the store is complete and left alone
+		auto found = store->storedObjects->find(guid);
+		return found ? *found : shared_ptr<BSONObjWithGUIDNode>();
+	}
+	storeLoaded();
+	auto found = storedObjects->find(guid);
+	if (!found && !doc->objectsScanned) {
+		storeAll();
+		found = storedObjects->find(guid);
+	}
+	return found ? *found : shared_ptr<BSONObjWithGUIDNode>();
+}
+
+size_t ofxBson::constructAll() {
+	storeAll();
+	// constructors read the tree from several threads: nothing may be left to build on reading
+	root->loadAll();
+	storeLoaded();
+
+	vector<shared_ptr<BSONObjWithGUIDNode>> objects;
+	ofxBsonUUIDMap<size_t> indices;
+	storedObjects->forEach([&](const ofxBsonUUID& guid, shared_ptr<BSONObjWithGUIDNode>& obj) {
+		if (!obj->constructedObject) {
+			indices[guid] = objects.size();
+			objects.push_back(obj);
+		}
+	});
+	size_t n = objects.size();
+	// what each object refers to among the ones to construct
+	vector<vector<size_t>> deps(n);
+	vector<ofxBsonUUID> guids;
+	for (size_t v = 0; v < n; v++) {
+		guids.clear();
+		objects[v]->references(guids);
+		for (auto& guid : guids) {
+			auto w = indices.find(guid);
+			if (w && *w != v) {
+				deps[v].push_back(*w);
+			}
+		}
+	}
+
+	// strongly connected components (Tarjan's, without recursion), so that every cycle
+	// becomes one piece of work. they are found dependencies first
+	vector<int> order(n, -1), low(n), component(n, -1);
+	vector<bool> onStack(n, false);
+	vector<size_t> stack;
+	vector<pair<size_t, size_t>> calls;
+	int counter = 0, components = 0;
+	auto visit = [&](size_t v) {
+		order[v] = low[v] = counter++;
+		stack.push_back(v);
+		onStack[v] = true;
+		calls.push_back(make_pair(v, (size_t)0));
+	};
+	for (size_t s = 0; s < n; s++) {
+		if (order[s] >= 0) {
+			continue;
+		}
+		visit(s);
+		while (!calls.empty()) {
+			size_t v = calls.back().first;
+			if (calls.back().second < deps[v].size()) {
+				size_t w = deps[v][calls.back().second++];
+				if (order[w] < 0) {
+					visit(w);
+				} else if (onStack[w]) {
+					low[v] = min(low[v], order[w]);
+				}
+				continue;
+			}
+			calls.pop_back();
+			if (!calls.empty()) {
+				size_t u = calls.back().first;
+				low[u] = min(low[u], low[v]);
+			}
+			if (low[v] == order[v]) {
+				size_t w;
+				do {
+					w = stack.back();
+					stack.pop_back();
+					onStack[w] = false;
+					component[w] = components;
+				} while (w != v);
+				components++;
+			}
+		}
+	}
+
+	vector<vector<size_t>> members(components), dependents(components);
+	unique_ptr<atomic<int>[]> waiting(new atomic<int>[components]);
+	for (int c = 0; c < components; c++) {
+		waiting[c] = 0;
+	}
+	for (size_t v = 0; v < n; v++) {
+		members[component[v]].push_back(v);
+		for (auto w : deps[v]) {
+			if (component[w] != component[v]) {
+				dependents[component[w]].push_back(component[v]);
+				waiting[component[v]]++;
+			}
+		}
+	}
+
+	if (!savePool) {
+		savePool = make_shared<ofxBsonThreadPool>(saveThreads);
+	}
+	auto& pool = *savePool;
+	// the views read the tree from the workers, and may name fields the document never had
+	doc->keys->share();
+	// read-only views reading through this ofxBson, one per worker at most: a view is taken
+	// for an object, entered at it, and given back for the next one
+	mutex viewsLock;
+	vector<unique_ptr<ofxBson>> views;
+	// the first exception of a constructor or linker, thrown once all the others ran
+	exception_ptr error;
+	auto withView = [&](const shared_ptr<BSONObjWithGUIDNode>& obj, const function<void(ofxBson&)>& fn) {
+		unique_ptr<ofxBson> view;
+		{
+			lock_guard<mutex> guard(viewsLock);
+			if (!views.empty()) {
+				view = move(views.back());
+				views.pop_back();
+			}
+		}
+		if (!view) {
+			view.reset(new ofxBson(*this, obj));
+			view->store = this;
+		}
+		view->setRoot(obj);
+		try {
+			fn(*view);
+		} catch (...) {
+			lock_guard<mutex> guard(viewsLock);
+			if (!error) {
+				error = current_exception();
+			}
+		}
+		lock_guard<mutex> guard(viewsLock);
+		views.push_back(move(view));
+	};
+	// a component is constructed once the ones it refers to are, then releases its dependents.
+	// an object whose constructor threw is left unconstructed: its dependents get null for it
+	function<void(size_t)> run = [&](size_t c) {
+		for (auto v : members[c]) {
+			withView(objects[v], [&](ofxBson& view) { objects[v]->construct(view); });
+		}
+		for (auto d : dependents[c]) {
+			if (--waiting[d] == 0) {
+				pool.submit([&run, d]() { run(d); });
+			}
+		}
+	};
+	for (int c = 0; c < components; c++) {
+		if (waiting[c] == 0) {
+			pool.submit([&run, c]() { run(c); });
+		}
+	}
+	pool.wait();
+
+	size_t constructed = storedObjects->size() - n;
+	for (auto& obj : objects) {
+		if (!obj->constructedObject) {
+			continue;
+		}
+		constructed++;
+		auto link = linkers.find(obj->type);
+		if (link != linkers.cend()) {
+			pool.submit([&withView, &obj, link]() {
+				withView(obj, [&](ofxBson& view) { link->second(view, obj->constructedObject); });
+			});
+		}
+	}
+	pool.wait();
+	if (error) {
+		rethrow_exception(error);
+	}
+	return constructed;
+}
+
+shared_ptr<ofxBson::BSONNode> ofxBson::guidNode(const ofxBsonUUID & guid, const string & type, const shared_ptr<BSONNode>& parent, const shared_ptr<BSONDocument>& d, bool & already_in_store) {
+	already_in_store = !!findObject(guid);
+	if (already_in_store) {
+		return makeNode<BSONGUIDNode>(d, guid, parent, this);
+	}
+	auto obj = makeNode<BSONObjWithGUIDNode>(d, guid, type, parent, this, d);
+	storeForWriting()[guid] = obj;
+	return obj;
+}
+
+void ofxBson::setIncrementalSave(bool incremental) {
+	incrementalSave = incremental;
+	doc->cacheSerialized = incremental;
+}
+
+/** one save() split across the thread pool. every task owns a disjoint slice of the output,
+	whose place is known up front from the sizes, so nothing is copied or synchronized
+	besides the task queues.
+*/
+struct ofxBson::ParallelSave {
+	typedef vector<pair<const ofxBsonKey*, shared_ptr<BSONNode>>> Fields;
+	typedef vector<shared_ptr<BSONNode>> Elements;
+
+	ofxBsonThreadPool& pool;
+	// values bigger than this are split further, runs of smaller ones are written by one task
+	long long grain;
+	atomic<bool> ok;
+
+	ParallelSave(ofxBsonThreadPool& pool, long long grain) : pool(pool), grain(grain), ok(true) {}
+
+	/** whether the value of node is worth splitting: big, and not written from bytes at hand */
+	bool splits(const shared_ptr<BSONNode>& node, long long size) const {
+		if (size <= grain) {
+			return false;
+		}
+		if (node->isArray() && node->getArray()) {
+			auto a = node->getArray();
+			return !a->isCached() && !a->isPacked();
+		}
+		if (node->isObject() && node->getObject() && !node->isGUID()) {
+			return !node->getObject()->isCached();
+		}
+		return false;
+	}
+
+	/** writes type and name of a field that is split, then splits its value in another task */
+	char* split(char* at, const char* name, size_t len, const shared_ptr<BSONNode>& node, long long size) {
+		bool arr = node->isArray();
+		*at++ = arr ? Array : Object;
+		memcpy(at, name, len);
+		at += len;
+		*at++ = 0;
+		char* value = at;
+		pool.submit([this, node, arr, value]() {
+			if (arr) {
+				node->getArray()->writeParallel(*this, value);
+			} else {
+				node->getObject()->writeParallel(*this, value);
+			}
+		});
+		return value + size;
+	}
+
+	void writeFields(char* at, long long size, Fields& fields) {
+		if (fields.empty()) {
+			return;
+		}
+		auto batch = make_shared<Fields>();
+		batch->swap(fields);
+		pool.submit([this, at, size, batch]() {
+			ofxBsonStreamWriter w(64);
+			w.open(at, (size_t)size);
+			for (auto& f : *batch) {
+				streamValue(w, f.first->name, f.second);
+			}
+			if (w.len() != size || !w.close()) {
+				ok = false;
+			}
+		});
+	}
+
+	void writeElements(char* at, long long size, unsigned first, Elements& items) {
+		if (items.empty()) {
+			return;
+		}
+		auto batch = make_shared<Elements>();
+		batch->swap(items);
+		pool.submit([this, at, size, first, batch]() {
+			ofxBsonStreamWriter w(64);
+			w.open(at, (size_t)size);
+			unsigned c = first;
+			char name[12];
+			for (auto& item : *batch) {
+				bsonarraybuilder::formatIndex(c++, name);
+				streamValue(w, name, item);
+			}
+			if (w.len() != size || !w.close()) {
+				ok = false;
+			}
+		});
+	}
+};
+
+void ofxBson::setParallelSave(bool parallel, size_t threads) {
+	parallelSave = parallel;
+	if (!parallel || threads != saveThreads) {
+		savePool.reset();
+	}
+	saveThreads = threads;
+}
+
+long long ofxBson::getSerializedSize() const {
+	return root->getObject()->getSerializedSize();
+}
+
+bool ofxBson::saveParallel(const string & path) {
+	long long size = getSerializedSize();
+	if (size > numeric_limits<int>::max()) {
+		return false;
+	}
+	ofBuffer out;
+	out.allocate((size_t)size);
+	if (!saveParallel(out.getData(), size)) {
+		return false;
+	}
+	return writeFile(ofToDataPath(path, true), bsonobj(out.getData()));
+}
+
+bool ofxBson::saveParallel(char * out, long long size) {
+	auto top = root->getObject();
+	if (!savePool) {
+		savePool = make_shared<ofxBsonThreadPool>(saveThreads);
+	}
+	// enough pieces to keep every worker busy while they steal from each other
+	long long grain = max(size / (long long)(savePool->size() * 16), 64LL * 1024);
+	ParallelSave job(*savePool, grain);
+	if (job.splits(root, size)) {
+		top->writeParallel(job, out);
+		savePool->wait();
+	} else {
+		ofxBsonStreamWriter w(64);
+		w.open(out, (size_t)size);
+		w.start();
+		top->constructInStream(w);
+		job.ok = w.len() == size && w.close();
+	}
+	return job.ok;
+}
+
+bool ofxBson::saveCached(bsonobj & o, shared_ptr<const void>& buf) {
+	long long size = getSerializedSize();
+	if (size > numeric_limits<int>::max() - 8) {
+		return false;
+	}
+	vector<pair<BSONNode*, int>> saved;
+	doc->saved = &saved;
+	// sized up front, so the builder never grows; it is kept as the buffer of the cache
+	auto b = make_shared<bsonobjbuilder>((int)size);
+	root->getObject()->constructInBuilder(*b);
+	doc->saved = 0;
+	o = b->done();
+	buf = b;
+	// the new bytes become the cache of everything that was written, rebuilt or copied
+	for (auto& s : saved) {
+		s.first->setSaved(bsonobj(o.objdata() + s.second), buf);
+	}
+	return true;
+}
+
+bool ofxBson::saveInto(char * out, long long size) {
+	if (incrementalSave) {
+		// the bytes are built where the cache keeps them, then copied out once
+		bsonobj o;
+		shared_ptr<const void> buf;
+		if (!saveCached(o, buf) || o.objsize() != size) {
+			return false;
+		}
+		memcpy(out, o.objdata(), (size_t)size);
 		return true;
 	}
-	return false;
+	if (parallelSave) {
+		return saveParallel(out, size);
+	}
+	ofxBsonStreamWriter w(64);
+	w.open(out, (size_t)size);
+	w.start();
+	root->getObject()->constructInStream(w);
+	return w.len() == size && w.close();
+}
+
+bool ofxBson::saveToBuffer(ofBuffer & buf) {
+	long long size = getSerializedSize();
+	if (size > numeric_limits<int>::max()) {
+		return false;
+	}
+	buf.allocate((size_t)size);
+	return saveInto(buf.getData(), size);
+}
+
+bool ofxBson::saveTo(vector<char>& out) {
+	long long size = getSerializedSize();
+	if (size > numeric_limits<int>::max()) {
+		return false;
+	}
+	out.resize((size_t)size);
+	return saveInto(out.data(), size);
+}
+
+bool ofxBson::exists(const string & name) const {
+	return current->getObject()->exists(name);
+}
+
+bool ofxBson::exists(size_t index) const {
+	return !!current->getArray()->getAt(index);
+}
+
+void ofxBson::addChild(const string& name) {
+	if (own()) {
+		current->getObject()->addChild(name);
+	}
+}
+
+size_t ofxBson::addChildToArray() {
+	if (!own()) {
+		return 0;
+	}
+	auto arr = current->getArray();
+	return arr->push(makeNode<BSONObjNode>(arr->doc, current, this, arr->doc));
+}
+
+void ofxBson::addArray(const string & name) {
+	if (own()) {
+		current->getObject()->addArray(name);
+	}
+}
+
+void ofxBson::addDoubleArray(const string & name, bool binary) {
+	if (own()) {
+		current->getObject()->addDoubleArray(name, binary);
+	}
+}
+
+void ofxBson::addInt32Array(const string & name, bool binary) {
+	if (own()) {
+		current->getObject()->addInt32Array(name, binary);
+	}
+}
+
+void ofxBson::addInt64Array(const string & name, bool binary) {
+	if (own()) {
+		current->getObject()->addInt64Array(name, binary);
+	}
+}
+
+size_t ofxBson::addArrayToArray() {
+	if (!own()) {
+		return 0;
+	}
+	auto arr = current->getArray();
+	return arr->push(makeNode<BSONArrayNode>(arr->doc, current, this, arr->doc));
+}
+
+bool ofxBson::setTo(const string & name) {
+	auto o = current->getObject();
+	if (!o) return false;
+	auto c = o->getChild(name);
+	if (!c) return false;
+	if (c->isGUID() && !c->isObject()) {
+		// a reference: the object it stands for is entered instead
+		return descendReference(c, name, string::npos);
+	}
+	if (c->isArray()) {
+		descend(c, name, string::npos);
+		return true;
+	}
+	auto p = c->getObject();
+	if (p) {
+		descend(p, name, string::npos);
+		return true;
+	}
+	return false;
+}
+
+bool ofxBson::setTo(size_t index) {
+	auto o = current->getArray();
+	if (!o) return false;
+	auto i = o->getAt(index);
+	if (i && i->isGUID() && !i->isObject()) {
+		return descendReference(i, "", index);
+	}
+	if (i) {
+		descend(i, "", index);
+		return true;
+	}
+	return false;
+}
+
+void ofxBson::setToParent() {
+	if (levels.size() > 1) {
+		levels.pop_back();
+		current = levels.back().node;
+	}
+}
+void ofxBson::setValue(const string & name, const string & value) {
+	if (own()) {
+		current->getObject()->addString(name, value);
+	}
+}
+size_t ofxBson::pushValue(const string & value) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushString(value);
+}
+void ofxBson::setValue(const string & name, double value) {
+	if (own()) {
+		current->getObject()->addNumber(name, value);
+	}
+}
+
+size_t ofxBson::pushValue(double value) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushNumber(value);
+}
+
+void ofxBson::setValue(const string & name, bool value) {
+	if (own()) {
+		current->getObject()->addBool(name, value);
+	}
+}
+
+size_t ofxBson::pushValue(bool value) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushBool(value);
+}
+
+void ofxBson::setValue(const string & name, int32_t value) {
+	if (own()) {
+		current->getObject()->addInt32(name, value);
+	}
+}
+
+size_t ofxBson::pushValue(int32_t value) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushInt32(value);
+}
+
+void ofxBson::setValue(const string & name, int64_t value) {
+	if (own()) {
+		current->getObject()->addInt64(name, value);
+	}
+}
+
+size_t ofxBson::pushValue(int64_t value) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushInt64(value);
+}
+
+void ofxBson::setNull(const string & name) {
+	if (own()) {
+		current->getObject()->addNull(name);
+	}
+}
+
+size_t ofxBson::pushNull() {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushNull();
+}
+
+size_t ofxBson::pushObject() {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushNewObject();
+}
+
+size_t ofxBson::pushArray() {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushNewArray();
+}
+
+void ofxBson::setBuffer(const string & name, const ofBuffer & value) {
+	if (own()) {
+		current->getObject()->addBuffer(name, value);
+	}
+}
+
+size_t ofxBson::pushBuffer(const ofBuffer & buf) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushBuffer(buf);
+}
+
+size_t ofxBson::pushValues(const double * values, size_t count) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushValues(values, count);
+}
+
+size_t ofxBson::pushValues(const int32_t * values, size_t count) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushValues(values, count);
+}
+
+size_t ofxBson::pushValues(const int64_t * values, size_t count) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushValues(values, count);
+}
+
+size_t ofxBson::getValues(double * values, size_t count, size_t offset) const {
+	return current->getArray()->getValues(values, count, offset);
+}
+
+size_t ofxBson::getValues(int32_t * values, size_t count, size_t offset) const {
+	return current->getArray()->getValues(values, count, offset);
+}
+
+size_t ofxBson::getValues(int64_t * values, size_t count, size_t offset) const {
+	return current->getArray()->getValues(values, count, offset);
+}
+
+void ofxBson::setGUIDObject(const string & name, const string & guid, bool & already_in_store) {
+	setGUIDObject(name, guid, "", already_in_store);
+}
+
+void ofxBson::setGUIDObject(const string & name, const string & guid, const string & type, bool & already_in_store) {
+	ofxBsonUUID parsed;
+	already_in_store = false;
+	if (ofxBsonUUID::parse(guid, parsed)) {
+		setGUIDObject(name, parsed, type, already_in_store);
+	}
+}
+
+void ofxBson::setGUIDObject(const string & name, const ofxBsonUUID & guid, const string & type, bool & already_in_store) {
+	if (own()) {
+		current->getObject()->addGUIDObject(name, guid, type, already_in_store);
+	}
+}
+
+size_t ofxBson::pushGUIDObject(const string & guid, bool & already_in_store) {
+	return pushGUIDObject(guid, "", already_in_store);
+}
+
+size_t ofxBson::pushGUIDObject(const string & guid, const string & type, bool & already_in_store) {
+	ofxBsonUUID parsed;
+	already_in_store = false;
+	if (!ofxBsonUUID::parse(guid, parsed)) {
+		return 0;
+	}
+	return pushGUIDObject(parsed, type, already_in_store);
+}
+
+size_t ofxBson::pushGUIDObject(const ofxBsonUUID & guid, const string & type, bool & already_in_store) {
+	if (!own()) {
+		return 0;
+	}
+	return current->getArray()->pushGUIDObject(guid, type, already_in_store);
+}
+
+void ofxBson::setUseArena(bool use, size_t blockSize) {
+	useArena = use;
+	arenaBlockSize = blockSize;
+	if (use) {
+		if (!doc->arena) {
+			doc->arena = make_shared<ofxBsonArena>(blockSize);
+		}
+	} else {
+		doc->arena.reset();
+	}
+}
+
+size_t ofxBson::getSize() const {
+	return current->getArray()->length();
+}
+
+shared_ptr<ofxBson::BSONNode> ofxBson::nodeFromElement(const bsonelement & elem, const shared_ptr<BSONNode>& parent, ofxBson* bson, const shared_ptr<BSONDocument>& doc, const shared_ptr<const void>& backing) {
+	switch (elem.type()) {
+	case jstNULL:
+		return makeNode<BSONNullNode>(doc, parent);
+	case Undefined:
+		return makeNode<BSONUndefinedNode>(doc, parent);
+	case Bool:
+		return makeNode<BSONBoolNode>(doc, elem.boolean(), parent);
+	case NumberDouble:
+		return makeNode<BSONNumberNode>(doc, elem._numberDouble(), parent);
+	case NumberInt:
+		return makeNode<BSONInt32Node>(doc, elem._numberInt(), parent);
+	case NumberLong:
+		return makeNode<BSONInt64Node>(doc, elem._numberLong(), parent);
+	case String:
+		return makeNode<BSONStringNode>(doc, string(elem.valuestr(), elem.valuestrsize() - 1), parent);
+	case Object:
+	{
+		bsonobj i_obj = elem.object();
+		shared_ptr<BSONObjNode> node;
+		if (i_obj.hasField("%type")) {
+			// objects with a guid are always read eagerly so that their identity is known
+			node = makeNode<BSONObjWithGUIDNode>(doc, parent, bson, doc);
+			node->loadFrom(i_obj, backing);
+		} else {
+			node = makeNode<BSONObjNode>(doc, parent, bson, doc);
+			if (backing) {
+				node->setLazy(i_obj, backing);
+			} else {
+				node->loadFrom(i_obj);
+			}
+		}
+		return node;
+	}
+	case Array:
+	{
+		bsonobj i_arr = elem.object();
+		shared_ptr<BSONArrayNode> node;
+		if (backing) {
+			node = makeNode<BSONArrayNode>(doc, parent, bson, doc);
+			node->setLazy(i_arr, backing);
+			return node;
+		}
+		// arrays of a single numeric type are read back packed; they unpack themselves if the guess was wrong
+		switch (i_arr.firstElementType()) {
+		case NumberDouble:
+			node = makeNode<BSONPackedDoubleArray>(doc, parent, bson, doc);
+			break;
+		case NumberInt:
+			node = makeNode<BSONPackedInt32Array>(doc, parent, bson, doc);
+			break;
+		case NumberLong:
+			node = makeNode<BSONPackedInt64Array>(doc, parent, bson, doc);
+			break;
+		default:
+			node = makeNode<BSONArrayNode>(doc, parent, bson, doc);
+			break;
+		}
+		node->loadFrom(i_arr);
+		return node;
+	}
+	case BinData:
+	{
+		int len = 0;
+		auto chstr = elem.binData(len);
+		if (elem.binDataType() == BinDataType::newUUID && len == ofxBsonUUID::Size) {
+			return makeNode<BSONGUIDNode>(doc, ofxBsonUUID(chstr), parent, bson);
+		}
+		if (lazyIsPackedArray(elem)) {
+			switch ((int)elem.binDataType()) {
+			case PackedDoubleBinData:
+			{
+				auto node = makeNode<BSONPackedDoubleArray>(doc, parent, bson, doc);
+				node->loadBinData(chstr, len);
+				return node;
+			}
+			case PackedInt32BinData:
+			{
+				auto node = makeNode<BSONPackedInt32Array>(doc, parent, bson, doc);
+				node->loadBinData(chstr, len);
+				return node;
+			}
+			case PackedInt64BinData:
+			{
+				auto node = makeNode<BSONPackedInt64Array>(doc, parent, bson, doc);
+				node->loadBinData(chstr, len);
+				return node;
+			}
+			}
+		}
+		return makeNode<BSONBufferNode>(doc, ofBuffer(chstr, len), parent);
+	}
+	case jstOID:
+		return makeNode<BSONGUIDNode>(doc, elementGUID(elem), parent, bson);
+	default:
+		return shared_ptr<BSONNode>();
+	}
+}
+
+double ofxBson::lazyNumber(const bsonelement & e) {
+	return e.isNumber() ? e.number() : numeric_limits<double>::signaling_NaN();
+}
+
+int32_t ofxBson::lazyInt32(const bsonelement & e) {
+	return e.type() == NumberInt ? e._numberInt() : numeric_limits<int32_t>::min();
+}
+
+int64_t ofxBson::lazyInt64(const bsonelement & e) {
+	switch (e.type()) {
+	case NumberInt: return e._numberInt();
+	case NumberLong: return e._numberLong();
+	default: return numeric_limits<int64_t>::min();
+	}
+}
+
+bool ofxBson::lazyBool(const bsonelement & e) {
+	return e.type() == Bool ? e.boolean() : false;
+}
+
+string ofxBson::lazyString(const bsonelement & e) {
+	return e.type() == String ? string(e.valuestr(), e.valuestrsize() - 1) : "";
+}
+
+bool ofxBson::lazyIsBuffer(const bsonelement & e) {
+	return e.type() == BinData && !lazyIsGUID(e) && !lazyIsPackedArray(e);
+}
+
+bool ofxBson::lazyIsPackedArray(const bsonelement & e) {
+	if (e.type() != BinData) {
+		return false;
+	}
+	int len = e.valuestrsize();
+	switch ((int)e.binDataType()) {
+	case PackedDoubleBinData: return len % sizeof(double) == 0;
+	case PackedInt32BinData: return len % sizeof(int32_t) == 0;
+	case PackedInt64BinData: return len % sizeof(int64_t) == 0;
+	default: return false;
+	}
+}
+
+bool ofxBson::lazyIsGUID(const bsonelement & e) {
+	switch (e.type()) {
+	case jstOID:
+		return true;
+	case BinData:
+		return e.binDataType() == BinDataType::newUUID && e.valuestrsize() == 16;
+	case Object:
+		return e.object().hasField("%type");
+	default:
+		return false;
+	}
+}
+
+ofxBsonUUID ofxBson::elementGUID(const bsonelement & e) {
+	int len = 0;
+	if (e.type() == BinData) {
+		auto bytes = e.binData(len);
+		if (len == ofxBsonUUID::Size) {
+			return ofxBsonUUID(bytes);
+		}
+	} else if (e.type() == jstOID) {
+		uint8_t bytes[ofxBsonUUID::Size] = { 0 };
+		memcpy(bytes, e.value(), 12);
+		return ofxBsonUUID(bytes);
+	}
+	return ofxBsonUUID();
+}
+
+void ofxBson::lazyReferences(const bsonobj & obj, vector<ofxBsonUUID>& guids) {
+	for (bsonelement e : obj) {
+		if (e.type() == Object && e.object().hasField("%type")) {
+			guids.push_back(elementGUID(e.object().getField("%guid")));
+		} else if (e.type() == Object || e.type() == Array) {
+			lazyReferences(e.object(), guids);
+		} else if (lazyIsGUID(e)) {
+			guids.push_back(elementGUID(e));
+		}
+	}
+}
+
+bool ofxBson::lazyHasObjects(const bsonobj & obj) {
+	for (bsonelement e : obj) {
+		if (e.type() == Object && e.object().hasField("%type")) {
+			return true;
+		}
+		if ((e.type() == Object || e.type() == Array) && lazyHasObjects(e.object())) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ofxBson::lazyFindObject(const bsonobj & obj, const ofxBsonUUID & guid, bsonobj & found) {
+	for (bsonelement e : obj) {
+		if (e.type() != Object && e.type() != Array) {
+			continue;
+		}
+		bsonobj child = e.object();
+		if (e.type() == Object && child.hasField("%type") && elementGUID(child.getField("%guid")) == guid) {
+			found = child;
+			return true;
+		}
+		if (lazyFindObject(child, guid, found)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void ofxBson::BSONObjNode::loadFrom(const _bson::bsonobj & obj, const shared_ptr<const void>& backing) {
+	auto self = shared_from_this();
+	for (bsonelement elem : obj) {
+		auto node = nodeFromElement(elem, self, bson, doc, backing);
+		if (node) {
+			content[keyFor(elem.fieldName(), elem.fieldNameSize() - 1)] = node;
+		}
+	}
+}
+
+void ofxBson::BSONObjNode::setLazy(const _bson::bsonobj & obj, const shared_ptr<const void>& buf) {
+	content.clear();
+	view = obj;
+	backing = buf;
+	lazy = true;
+	dirty = false;
+}
+
+void ofxBson::BSONObjNode::materialize() {
+	if (!lazy) {
+		return;
+	}
+	lazy = false;
+	loadFrom(view, backing);
+	if (!doc || !doc->cacheSerialized) {
+		view = bsonobj();
+		backing.reset();
+	}
+}
+
+void ofxBson::BSONObjNode::loadAll() {
+	if (isShared()) {
+		return;
+	}
+	materialize();
+	for (auto& item : content) {
+		item.second->loadAll();
+	}
+}
+
+void ofxBson::BSONObjNode::loadObjects() {
+	if (isShared() || (lazy && !lazyHasObjects(view))) {
+		return;
+	}
+	materialize();
+	for (auto& item : content) {
+		item.second->loadObjects();
+	}
+}
+
+void ofxBson::BSONObjNode::sharedObjectHolders(vector<Level>& at, vector<vector<Level>>& paths) const {
+	if (lazy) {
+		if (isShared() && lazyHasObjects(view)) {
+			paths.push_back(at);
+		}
+		return;
+	}
+	for (auto& item : content) {
+		Level step;
+		step.node = item.second;
+		step.name = item.first->name;
+		at.push_back(step);
+		item.second->sharedObjectHolders(at, paths);
+		at.pop_back();
+	}
+}
+
+bool ofxBson::BSONObjNode::lookUpObject(const ofxBsonUUID & guid, shared_ptr<BSONNode>& found, bsonobj & bytes, shared_ptr<const void>& buf) const {
+	if (lazy) {
+		if (!lazyFindObject(view, guid, bytes)) {
+			return false;
+		}
+		buf = backing;
+		return true;
+	}
+	for (auto& item : content) {
+		if (item.second->lookUpObject(guid, found, bytes, buf)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void ofxBson::BSONObjNode::references(vector<ofxBsonUUID>& guids) const {
+	if (lazy) {
+		lazyReferences(view, guids);
+		return;
+	}
+	for (auto& item : content) {
+		if (item.second->isGUID()) {
+			guids.push_back(item.second->getUUID());
+		} else {
+			item.second->references(guids);
+		}
+	}
+}
+
+bool ofxBson::BSONObjNode::pathTo(const BSONNode * target, vector<Level>& steps) const {
+	if (lazy) {
+		return false;
+	}
+	for (auto& item : content) {
+		if (item.second.get() == target || item.second->pathTo(target, steps)) {
+			Level step;
+			step.node = item.second;
+			step.name = item.first->name;
+			steps.push_back(step);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ofxBson::BSONArrayNode::loadFrom(const _bson::bsonobj & obj, const shared_ptr<const void>& backing) {
+	auto self = shared_from_this();
+	for (bsonelement elem : obj) {
+		auto node = nodeFromElement(elem, self, bson, doc, backing);
+		if (node) {
+			items.push_back(node);
+		}
+	}
+}
+
+void ofxBson::BSONArrayNode::setLazy(const _bson::bsonobj & obj, const shared_ptr<const void>& buf) {
+	items.clear();
+	view = obj;
+	backing = buf;
+	lazy = true;
+	lazyLength = -1;
+	dirty = false;
+}
+
+void ofxBson::BSONArrayNode::materialize() {
+	if (!lazy) {
+		return;
+	}
+	lazy = false;
+	loadFrom(view, backing);
+	if (!doc || !doc->cacheSerialized) {
+		view = bsonobj();
+		backing.reset();
+	}
+}
+
+void ofxBson::BSONArrayNode::loadAll() {
+	if (isShared()) {
+		return;
+	}
+	materialize();
+	for (auto& item : items) {
+		item->loadAll();
+	}
+}
+
+void ofxBson::BSONArrayNode::loadObjects() {
+	if (isShared() || (lazy && !lazyHasObjects(view))) {
+		return;
+	}
+	materialize();
+	for (auto& item : items) {
+		item->loadObjects();
+	}
+}
+
+void ofxBson::BSONArrayNode::sharedObjectHolders(vector<Level>& at, vector<vector<Level>>& paths) const {
+	if (lazy) {
+		if (isShared() && lazyHasObjects(view)) {
+			paths.push_back(at);
+		}
+		return;
+	}
+	for (size_t i = 0; i < items.size(); i++) {
+		Level step;
+		step.node = items[i];
+		step.index = i;
+		at.push_back(step);
+		items[i]->sharedObjectHolders(at, paths);
+		at.pop_back();
+	}
+}
+
+bool ofxBson::BSONArrayNode::lookUpObject(const ofxBsonUUID & guid, shared_ptr<BSONNode>& found, bsonobj & bytes, shared_ptr<const void>& buf) const {
+	if (lazy) {
+		if (!lazyFindObject(view, guid, bytes)) {
+			return false;
+		}
+		buf = backing;
+		return true;
+	}
+	for (auto& item : items) {
+		if (item->lookUpObject(guid, found, bytes, buf)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void ofxBson::BSONArrayNode::references(vector<ofxBsonUUID>& guids) const {
+	if (lazy) {
+		lazyReferences(view, guids);
+		return;
+	}
+	for (auto& item : items) {
+		if (item->isGUID()) {
+			guids.push_back(item->getUUID());
+		} else {
+			item->references(guids);
+		}
+	}
+}
+
+bool ofxBson::BSONArrayNode::pathTo(const BSONNode * target, vector<Level>& steps) const {
+	if (lazy) {
+		return false;
+	}
+	for (size_t i = 0; i < items.size(); i++) {
+		if (items[i].get() == target || items[i]->pathTo(target, steps)) {
+			Level step;
+			step.node = items[i];
+			step.index = i;
+			steps.push_back(step);
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t ofxBson::BSONArrayNode::getValues(double * out, size_t count, size_t offset) const {
+	if (lazy && isShared()) {
+		return detachedValues(out, count, offset, &ofxBson::lazyNumber);
+	}
+	size_t n = length();
+	if (offset >= n) {
+		return 0;
+	}
+	count = std::min(count, n - offset);
+	for (size_t i = 0; i < count; i++) {
+		out[i] = getNumberAt(offset + i);
+	}
+	return count;
+}
+
+size_t ofxBson::BSONArrayNode::getValues(int32_t * out, size_t count, size_t offset) const {
+	if (lazy && isShared()) {
+		return detachedValues(out, count, offset, &ofxBson::lazyInt32);
+	}
+	size_t n = length();
+	if (offset >= n) {
+		return 0;
+	}
+	count = std::min(count, n - offset);
+	for (size_t i = 0; i < count; i++) {
+		out[i] = getInt32At(offset + i);
+	}
+	return count;
+}
+
+size_t ofxBson::BSONArrayNode::getValues(int64_t * out, size_t count, size_t offset) const {
+	if (lazy && isShared()) {
+		return detachedValues(out, count, offset, &ofxBson::lazyInt64);
+	}
+	size_t n = length();
+	if (offset >= n) {
+		return 0;
+	}
+	count = std::min(count, n - offset);
+	for (size_t i = 0; i < count; i++) {
+		out[i] = getInt64At(offset + i);
+	}
+	return count;
+}
+
+size_t ofxBson::BSONArrayNode::pushValues(const double * values, size_t count) {
+	materialize();
+	size_t first = items.size();
+	auto self = shared_from_this();
+	for (size_t i = 0; i < count; i++) {
+		push(makeNode<BSONNumberNode>(doc, values[i], self));
+	}
+	return first;
+}
+
+size_t ofxBson::BSONArrayNode::pushValues(const int32_t * values, size_t count) {
+	materialize();
+	size_t first = items.size();
+	auto self = shared_from_this();
+	for (size_t i = 0; i < count; i++) {
+		push(makeNode<BSONInt32Node>(doc, values[i], self));
+	}
+	return first;
+}
+
+size_t ofxBson::BSONArrayNode::pushValues(const int64_t * values, size_t count) {
+	materialize();
+	size_t first = items.size();
+	auto self = shared_from_this();
+	for (size_t i = 0; i < count; i++) {
+		push(makeNode<BSONInt64Node>(doc, values[i], self));
+	}
+	return first;
+}
+
+size_t ofxBson::BSONArrayNode::length() const {
+	if (lazy) {
+		if (lazyLength < 0) {
+			if (isShared()) {
+				return view.nFields();
+			}
+			const_cast<BSONArrayNode*>(this)->lazyLength = view.nFields();
+		}
+		return lazyLength;
+	}
+	return items.size();
+}
+
+void ofxBson::BSONObjNode::addGUIDObject(const string & name, const ofxBsonUUID & guid, const string& type, bool & already_in_store) {
+	materialize();
+	content[keyFor(name)] = bson->guidNode(guid, type, shared_from_this(), doc, already_in_store);
+	markDirty();
+}
+
+inline bool ofxBson::BSONObjNode::exists(const string & name) const {
+	if (lazy) return view.hasField(name);
+	return (content.find(name) != content.cend());
+}
+
+// whether the bytes of inner lie within those of outer
+static bool within(const bsonobj & inner, const bsonobj & outer) {
+	return inner.objdata() >= outer.objdata() && inner.objdata() + inner.objsize() <= outer.objdata() + outer.objsize();
+}
+
+// copied along with an ancestor, the bytes of a cached container sit at the same distance from
+// the start of the copy. ones that were not part of it can't be found in the output, and are
+// dropped rather than keeping the buffer of an older save alive
+void ofxBson::BSONObjNode::noteCopied(const bsonobj & from, int offset) {
+	if (!doc || !doc->saved) {
+		return;
+	}
+	if (backing) {
+		if (within(view, from)) {
+			doc->saved->push_back(make_pair((BSONNode*)this, offset + (int)(view.objdata() - from.objdata())));
+		} else if (!lazy) {
+			view = bsonobj();
+			backing.reset();
+		}
+	}
+	for (auto& item : content) {
+		item.second->noteCopied(from, offset);
+	}
+}
+
+void ofxBson::BSONArrayNode::noteCopied(const bsonobj & from, int offset) {
+	if (!doc || !doc->saved) {
+		return;
+	}
+	if (backing) {
+		if (within(view, from)) {
+			doc->saved->push_back(make_pair((BSONNode*)this, offset + (int)(view.objdata() - from.objdata())));
+		} else if (!lazy) {
+			view = bsonobj();
+			backing.reset();
+		}
+	}
+	for (auto& item : items) {
+		item->noteCopied(from, offset);
+	}
+}
+
+template <typename Encoder>
+typename Encoder::Result ofxBson::encodeValue(Encoder & e, const shared_ptr<BSONNode>& node) {
+	if (node->isObject()) {
+		auto obj = node->getObject();
+		return obj ? e.object(*obj) : e.null();
+	} else if (node->isArray()) {
+		auto arr = node->getArray();
+		if (!arr) {
+			return e.skip();
+		}
+		const void* data;
+		int len;
+		BinDataType type;
+		if (arr->getPackedBinData(data, len, type)) {
+			return e.binData(len, type, data);
+		}
+		return e.array(*arr);
+	} else if (node->isNull()) {
+		return e.null();
+	} else if (node->isBool()) {
+		return e.boolean(node->getBool());
+	} else if (node->isNumber()) {
+		return e.number(node->getNumber());
+	} else if (node->isInt32()) {
+		return e.int32((int)node->getInt32());
+	} else if (node->isInt64()) {
+		return e.int64((long long)node->getInt64());
+	} else if (node->isBuffer()) {
+		const ofBuffer& buf = node->getBuffer();
+		return e.binData((int)buf.size(), BinDataType::BinDataGeneral, buf.getBinaryBuffer());
+	} else if (node->isString()) {
+		return e.text(node->getString());
+	} else if (node->isGUID()) {
+		ofxBsonUUID guid = node->getUUID();
+		return e.binData(ofxBsonUUID::Size, BinDataType::newUUID, guid.bytes);
+	}
+	return e.skip();
+}
+
+// a field of an object being built
+struct ofxBson::FieldBuilder {
+	typedef bool Result;
+	bsonobjbuilder& b;
+	const string& name;
+
+	bool null() { b.appendNull(name); return true; }
+	bool boolean(bool v) { b.appendBool(name, v); return true; }
+	bool number(double v) { b.appendNumber(name, v); return true; }
+	bool int32(int v) { b.append(name, v); return true; }
+	bool int64(long long v) { b.append(name, v); return true; }
+	bool text(const string& v) { b.append(name, v); return true; }
+	bool binData(int len, BinDataType type, const void* data) { b.appendBinData(name, len, type, data); return true; }
+	bool object(const BSONObjNode& obj) {
+		bsonobjbuilder sub(b.subobjStart(name));
+		obj.constructInBuilder(sub);
+		return true;
+	}
+	bool array(BSONArrayNode& arr) {
+		bsonarraybuilder sub(b.subarrayStart(name));
+		arr.constructInBuilder(sub);
+		sub._done();
+		return true;
+	}
+	bool skip() { return false; }
+};
+
+// the next element of an array being built, numbered by the builder
+struct ofxBson::ElementBuilder {
+	typedef bool Result;
+	bsonarraybuilder& b;
+
+	bool null() { b.appendNull(); return true; }
+	bool boolean(bool v) { b.appendBool(v); return true; }
+	bool number(double v) { b.append(v); return true; }
+	bool int32(int v) { b.append(v); return true; }
+	bool int64(long long v) { b.append(v); return true; }
+	bool text(const string& v) { b.append(v); return true; }
+	bool binData(int len, BinDataType type, const void* data) { b.appendBinData(len, type, data); return true; }
+	bool object(const BSONObjNode& obj) {
+		bsonobjbuilder sub(b.subobjStart());
+		obj.constructInBuilder(sub);
+		sub._done();
+		return true;
+	}
+	bool array(BSONArrayNode& arr) {
+		bsonarraybuilder sub(b.subarrayStart());
+		arr.constructInBuilder(sub);
+		sub._done();
+		return true;
+	}
+	bool skip() { return false; }
+};
+
+// a field or element written to a stream
+struct ofxBson::StreamEncoder {
+	typedef bool Result;
+	ofxBsonStreamWriter& w;
+	const StringData& name;
+
+	bool null() { w.appendNull(name); return true; }
+	bool boolean(bool v) { w.appendBool(name, v); return true; }
+	bool number(double v) { w.appendNumber(name, v); return true; }
+	bool int32(int v) { w.append(name, v); return true; }
+	bool int64(long long v) { w.append(name, v); return true; }
+	bool text(const string& v) { w.append(name, v); return true; }
+	bool binData(int len, BinDataType type, const void* data) { w.appendBinData(name, len, type, data); return true; }
+	bool object(const BSONObjNode& obj) {
+		w.subobjStart(name);
+		obj.constructInStream(w);
+		return true;
+	}
+	bool array(const BSONArrayNode& arr) {
+		w.subarrayStart(name);
+		arr.constructInStream(w);
+		w.done();
+		return true;
+	}
+	bool skip() { return false; }
+};
+
+// the bytes the encoders above write for a value, type and name aside
+struct ofxBson::ValueSize {
+	typedef long long Result;
+
+	long long null() { return 0; }
+	long long boolean(bool) { return 1; }
+	long long number(double) { return sizeof(double); }
+	long long int32(int) { return sizeof(int); }
+	long long int64(long long) { return sizeof(long long); }
+	long long text(const string& v) { return 4 + (long long)v.size() + 1; }
+	long long binData(int len, BinDataType, const void*) { return 4 + 1 + (long long)len; }
+	long long object(const BSONObjNode& obj) { return obj.getSerializedSize(); }
+	long long array(const BSONArrayNode& arr) { return arr.getSerializedSize(); }
+	long long skip() { return -1; }
+};
+
+inline void ofxBson::BSONObjNode::constructInBuilder(bsonobjbuilder & b) const {
+	int offset = b.len() - 4;
+	if (doc && doc->saved) {
+		doc->saved->push_back(make_pair((BSONNode*)this, offset));
+	}
+	if (isCached()) {
+		// untouched since load or the last save: the bytes there are still valid
+		b.appendElements(view);
+		b.done();
+		// and so are those of the containers below, which moved along with them
+		if (doc && doc->saved) {
+			for (auto& item : content) {
+				item.second->noteCopied(view, offset);
+			}
+		}
+		return;
+	}
+	for (auto& item : content) {
+		FieldBuilder e = { b, item.first->name };
+		encodeValue(e, item.second);
+	}
+	b.done();
+}
+
+void ofxBson::BSONArrayNode::constructInBuilder(bsonarraybuilder & builder) {
+	int offset = builder.len() - 4;
+	noteSaved(offset);
+	if (isCached()) {
+		builder.appendElements(view);
+		if (doc && doc->saved) {
+			for (auto& item : items) {
+				item->noteCopied(view, offset);
+			}
+		}
+		return;
+	}
+	for (auto& item : items) {
+		ElementBuilder e = { builder };
+		encodeValue(e, item);
+	}
+}
+
+void ofxBson::BSONObjNode::constructInStream(ofxBsonStreamWriter & w) const {
+	if (isCached()) {
+		w.appendElements(view);
+		w.done();
+		return;
+	}
+	for (auto&item : content) {
+		streamValue(w, item.first->name, item.second);
+	}
+	w.done();
+}
+
+void ofxBson::BSONArrayNode::constructInStream(ofxBsonStreamWriter & w) const {
+	if (isCached()) {
+		w.appendElements(view);
+		return;
+	}
+	// same keys bsonarraybuilder generates: only elements actually written are numbered
+	unsigned c = 0;
+	char name[12];
+	for (auto& item : items) {
+		bsonarraybuilder::formatIndex(c, name);
+		if (streamValue(w, name, item)) {
+			c++;
+		}
+	}
+}
+
+bool ofxBson::streamValue(ofxBsonStreamWriter & w, const StringData & name, const shared_ptr<BSONNode>& node) {
+	StreamEncoder e = { w, name };
+	return encodeValue(e, node);
+}
+
+long long ofxBson::valueSize(const shared_ptr<BSONNode>& node) {
+	ValueSize e;
+	return encodeValue(e, node);
+}
+
+long long ofxBson::BSONObjNode::getSerializedSize() const {
+	if (isCached()) {
+		return view.objsize();
+	}
+	if (knownSize < 0) {
+		long long size = 4 + 1;
+		for (auto& item : content) {
+			long long value = valueSize(item.second);
+			if (value >= 0) {
+				size += 1 + item.first->name.size() + 1 + value;
+			}
+		}
+		knownSize = size;
+	}
+	return knownSize;
+}
+
+long long ofxBson::BSONArrayNode::getSerializedSize() const {
+	if (isCached()) {
+		return view.objsize();
+	}
+	if (knownSize < 0) {
+		long long size = 4 + 1;
+		unsigned c = 0;
+		char name[12];
+		for (auto& item : items) {
+			long long value = valueSize(item);
+			if (value >= 0) {
+				size += 1 + bsonarraybuilder::formatIndex(c++, name) + value;
+			}
+		}
+		knownSize = size;
+	}
+	return knownSize;
 }
 
-bool ofxBson::save(const string & path) {
-	ofFile toSave(path, ofFile::Mode::WriteOnly, true);
-	bsonobjbuilder b;
-	root->getObject()->constructInBuilder(b);
-	ofBuffer buf = ofBuffer(b.obj().objdata(), b.obj().objsize());
-	toSave.writeFromBuffer(buf);
-	toSave.close();
-	return true;
+void ofxBson::BSONObjNode::writeParallel(ParallelSave & job, char * at) const {
+	long long size = getSerializedSize();
+	int prefix = endian_int((int)size);
+	memcpy(at, &prefix, 4);
+	at[size - 1] = EOO;
+	char* p = at + 4;
+	ParallelSave::Fields batch;
+	char* batchAt = p;
+	for (auto& item : content) {
+		long long value = valueSize(item.second);
+		if (value < 0) {
+			continue;
+		}
+		const string& name = item.first->name;
+		if (job.splits(item.second, value)) {
+			job.writeFields(batchAt, p - batchAt, batch);
+			p = job.split(p, name.c_str(), name.size(), item.second, value);
+			batchAt = p;
+			continue;
+		}
+		batch.push_back(item);
+		p += 1 + name.size() + 1 + value;
+		if (p - batchAt >= job.grain) {
+			job.writeFields(batchAt, p - batchAt, batch);
+			batchAt = p;
+		}
+	}
+	job.writeFields(batchAt, p - batchAt, batch);
 }
 
+void ofxBson::BSONArrayNode::writeParallel(ParallelSave & job, char * at) const {
+	long long size = getSerializedSize();
+	int prefix = endian_int((int)size);
+	memcpy(at, &prefix, 4);
+	at[size - 1] = EOO;
+	char* p = at + 4;
+	ParallelSave::Elements batch;
+	char* batchAt = p;
+	unsigned c = 0, batchFirst = 0;
+	char name[12];
+	for (auto& item : items) {
+		long long value = valueSize(item);
+		if (value < 0) {
+			continue;
+		}
+		int len = bsonarraybuilder::formatIndex(c++, name);
+		if (job.splits(item, value)) {
+			job.writeElements(batchAt, p - batchAt, batchFirst, batch);
+			p = job.split(p, name, len - 1, item, value);
+			batchAt = p;
+			batchFirst = c;
+			continue;
+		}
+		batch.push_back(item);
+		p += 1 + len + value;
+		if (p - batchAt >= job.grain) {
+			job.writeElements(batchAt, p - batchAt, batchFirst, batch);
+			batchAt = p;
+			batchFirst = c;
+		}
+	}
+	job.writeElements(batchAt, p - batchAt, batchFirst, batch);
+}
 
-bool ofxBson::exists(const string & name) const {
-	return current->getObject()->exists(name);
+
+shared_ptr<ofxBson::BSONNode> ofxBson::cloneChild(const shared_ptr<BSONNode>& child, weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) {
+	if (child->isArray()) {
+		return child->getArray()->clone(parent, d);
+	}
+	if (child->isObject()) {
+		return child->getObject()->clone(parent, d);
+	}
+	return child;
 }
 
-bool ofxBson::exists(size_t index) const {
-	return !!current->getArray()->getAt(index);
+shared_ptr<ofxBson::BSONObjNode> ofxBson::BSONObjNode::clone(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const {
+	auto copy = makeNode<BSONObjNode>(d, parent, bson, d);
+	cloneContent(copy, d);
+	return copy;
 }
 
-void ofxBson::addChild(const string& name) {
-	current->getObject()->addChild(name);
+void ofxBson::BSONObjNode::cloneContent(const shared_ptr<BSONObjNode>& copy, const shared_ptr<BSONDocument>& d) const {
+	if (isCached()) {
+		copy->setLazy(view, backing);
+		return;
+	}
+	copy->content.reserve(content.size());
+	for (auto& item : content) {
+		copy->content[item.first] = cloneChild(item.second, copy, d);
+	}
 }
 
-size_t ofxBson::addChildToArray() {
-	return current->getArray()->push(make_shared<BSONObjNode>(current));
+shared_ptr<ofxBson::BSONArrayNode> ofxBson::BSONArrayNode::clone(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const {
+	auto copy = makeNode<BSONArrayNode>(d, parent, bson, d);
+	cloneItems(copy, d);
+	return copy;
 }
 
-void ofxBson::addArray(const string & name) {
-	return current->getObject()->addArray(name);
+void ofxBson::BSONArrayNode::cloneItems(const shared_ptr<BSONArrayNode>& copy, const shared_ptr<BSONDocument>& d) const {
+	if (isCached()) {
+		copy->setLazy(view, backing);
+		return;
+	}
+	copy->items.reserve(items.size());
+	for (auto& item : items) {
+		copy->items.push_back(cloneChild(item, copy, d));
+	}
 }
 
-size_t ofxBson::addArrayToArray() {
-	return current->getArray()->push(make_shared<BSONArrayNode>(current));
+shared_ptr<ofxBson::BSONObjNode> ofxBson::BSONObjNode::copy(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const {
+	auto to = makeNode<BSONObjNode>(d, parent, bson, d);
+	copyState(to);
+	return to;
 }
 
-bool ofxBson::setTo(const string & name) {
-	auto o = current->getObject();
-	if (!o) return false;
-	auto p = o->getChild(name)->getObject();
-	if (p) {
-		current = p;
-		return true;
+void ofxBson::BSONObjNode::copyState(const shared_ptr<BSONObjNode>& to) const {
+	to->content = content;
+	to->type = type;
+	to->view = view;
+	to->backing = backing;
+	to->lazy = lazy;
+	to->dirty = dirty;
+	to->knownSize = knownSize.load();
+}
+
+shared_ptr<ofxBson::BSONNode> ofxBson::BSONObjNode::detachedChild(const bsonelement & elem) const {
+	if (elem.eoo()) {
+		return shared_ptr<BSONNode>();
 	}
-	return false;
+	return nodeFromElement(elem, const_cast<BSONObjNode*>(this)->shared_from_this(), bson, doc, backing);
 }
 
-bool ofxBson::setTo(size_t index) {
-	auto o = current->getArray();
-	if (!o) return false;
-	auto i = o->getAt(index);
-	if (i) {
-		current = i;
-		return true;
+shared_ptr<ofxBson::BSONArrayNode> ofxBson::BSONArrayNode::copy(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const {
+	auto to = makeNode<BSONArrayNode>(d, parent, bson, d);
+	copyState(to);
+	return to;
+}
+
+void ofxBson::BSONArrayNode::copyState(const shared_ptr<BSONArrayNode>& to) const {
+	to->items = items;
+	to->view = view;
+	to->backing = backing;
+	to->lazy = lazy;
+	to->lazyLength = lazyLength;
+	to->dirty = dirty;
+	to->knownSize = knownSize.load();
+}
+
+shared_ptr<ofxBson::BSONNode> ofxBson::BSONArrayNode::detachedAt(size_t i) const {
+	bsonobjiterator it(view);
+	for (size_t n = 0; it.more(); n++) {
+		bsonelement elem = it.next();
+		if (n == i) {
+			return nodeFromElement(elem, const_cast<BSONArrayNode*>(this)->shared_from_this(), bson, doc, backing);
+		}
 	}
-	return false;
+	return shared_ptr<BSONNode>();
 }
 
-void ofxBson::setToParent() {
-	auto p = current->getParent();
-	if (!p.expired()) {
-		current = p.lock()->getObject();
+template <typename T>
+size_t ofxBson::BSONArrayNode::detachedValues(T * out, size_t count, size_t offset, T (*read)(const bsonelement&)) const {
+	bsonobjiterator it(view);
+	size_t n = 0;
+	for (size_t i = 0; n < count && it.more(); i++) {
+		bsonelement elem = it.next();
+		if (i >= offset) {
+			out[n++] = read(elem);
+		}
 	}
+	return n;
 }
-void ofxBson::setValue(const string & name, const string & value) {
-	current->getObject()->addString(name, value);
+
+bsonobj ofxBson::BSONObjNode::obj() const {
+	if (isCached()) {
+		return view;
+	}
+	long long size = getSerializedSize();
+	auto bytes = make_shared<ofBuffer>();
+	bytes->allocate((size_t)size);
+	ofxBsonStreamWriter w(64);
+	w.open(bytes->getData(), (size_t)size);
+	w.start();
+	constructInStream(w);
+	if (w.len() != size || !w.close()) {
+		return bsonobj();
+	}
+	objBytes = bytes;
+	return bsonobj(objBytes->getData());
 }
-size_t ofxBson::pushValue(const string & value) {
-	return current->getArray()->pushString(value);
+
+int ofxBson::getIntValue(const string & name) const {
+	return current->getObject()->getNumber(name);
 }
-void ofxBson::setValue(const string & name, double value) {
-	current->getObject()->addNumber(name, value);
+
+int ofxBson::getIntValue(size_t index) const {
+	return current->getArray()->getNumberAt(index);
 }
 
-size_t ofxBson::pushValue(double value) {
-	return current->getArray()->pushNumber(value);
+float ofxBson::getFloatValue(const string & name) const {
+	return current->getObject()->getNumber(name);
 }
 
-void ofxBson::setValue(const string & name, bool value) {
-	current->getObject()->addBool(name, value);
+float ofxBson::getFloatValue(size_t index) const {
+	return current->getArray()->getNumberAt(index);
 }
 
-size_t ofxBson::pushValue(bool value) {
-	return current->getArray()->pushBool(value);
+double ofxBson::getDoubleValue(const string & name) const {
+	return current->getObject()->getNumber(name);
 }
 
-void ofxBson::setValue(const string & name, int32_t value) {
-	return current->getObject()->addInt32(name, value);
+double ofxBson::getDoubleValue(size_t index) const {
+	return current->getArray()->getNumberAt(index);
 }
 
-void ofxBson::setValue(const string & name, int64_t value) {
-	return current->getObject()->addInt64(name, value);
+int64_t ofxBson::getInt64Value(const string & name) const {
+	return current->getObject()->getInt64(name);
 }
 
-void ofxBson::setNull(const string & name) {
-	return current->getObject()->addNull(name);
+int64_t ofxBson::getInt64Value(size_t index) const {
+	return current->getArray()->getInt64At(index);
 }
 
-size_t ofxBson::pushNull() {
-	return current->getArray()->pushNull();
+bool ofxBson::getBoolValue(const string & name) const {
+	return current->getObject()->getBool(name);
 }
 
-size_t ofxBson::pushObject() {
-	return current->getArray()->pushNewObject();
+string ofxBson::getValue(const string & name) const {
+	return current->getObject()->getString(name);
 }
 
-size_t ofxBson::pushArray() {
-	return current->getArray()->pushNewArray();
+bool ofxBson::getBoolValue(size_t index) const {
+	return current->getArray()->getAt(index)->getBool();
 }
 
-void ofxBson::setBuffer(const string & name, const ofBuffer & value) {
-	current->getObject()->addBuffer(name, value);
+string ofxBson::getValue(size_t index) const {
+	return current->getArray()->getAt(index)->getString();
 }
 
-void ofxBson::setGUIDObject(const string & name, const string & guid, bool & already_in_store) {
-	current->getObject()->addGUIDObject(name, guid, "", already_in_store);
+string ofxBson::getGUID(const string & name) const {
+	return current->getObject()->getChild(name)->getGUID();
 }
 
-void ofxBson::setGUIDObject(const string & name, const string & guid, const string & type, bool & already_in_store) {
-	current->getObject()->addGUIDObject(name, guid, type, already_in_store);
+string ofxBson::getGUID(size_t index) const {
+	return current->getArray()->getAt(index)->getGUID();
 }
 
-size_t ofxBson::pushGUIDObject(const string & guid, bool & already_in_store) {
-	return current->getArray()->pushGUIDObject(guid, already_in_store);
+ofxBsonUUID ofxBson::getUUID(const string & name) const {
+	return current->getObject()->getChild(name)->getUUID();
 }
 
-size_t ofxBson::getSize() const {
-	return current->getArray()->length();
+ofxBsonUUID ofxBson::getUUID(size_t index) const {
+	return current->getArray()->getAt(index)->getUUID();
 }
 
-ofxBson::BSONObjNode::BSONObjNode(const _bson::bsonobj & obj,  weak_ptr<BSONNode> _parent):
-	BSONNode(_parent)
-{
-	list<bsonelement> elems;
-	obj.elems(elems);
-	for (auto& elem : elems) {
-		string name = elem.fieldName();
-		if (elem.isNull()) {
-			addNull(name);
+ofxBson::Path::Path(const string & dotted) : dotted(dotted), doc(0), version(0), node(0), array(0), index(0) {
+	size_t start = 0;
+	for (;;) {
+		size_t end = dotted.find('.', start);
+		Step s;
+		s.name = dotted.substr(start, end == string::npos ? string::npos : end - start);
+		s.index = string::npos;
+		if (!s.name.empty() && s.name.size() < 10 && s.name.find_first_not_of("0123456789") == string::npos) {
+			s.index = strtoul(s.name.c_str(), 0, 10);
 		}
-		else if (elem.isBoolean()) {
-			addBool(name, elem.boolean());
-		}
-		else if (elem.isNumber()) {
-			addNumber(name,elem.number());
-		}
-		else if (elem.isObject()) {
-			auto i_obj = elem.object();
-			if (i_obj.hasField("%type")) {
-				content[name] = make_shared<BSONObjWithGUIDNode>(i_obj, shared_from_this());
-			} else {
-				content[name] = make_shared<BSONObjNode>(elem.object(), shared_from_this());
-			}
-		}
-		else {
-			switch (elem.type()) {
-			case BSONType::BinData:
-				{
-					int len = 0;
-					auto chstr = elem.binData(len);
-					switch (elem.binDataType()) {
-					case BinDataType::newUUID:
-						boost::uuids::uuid uid;
-						memcpy(uid.data, chstr, 16);
-						content[name] = make_shared<BSONGUIDNode>(boost::lexical_cast<string>(uid), shared_from_this());
-						break;
-					case BinDataType::BinDataGeneral:
-					{
-						ofBuffer buf(chstr, len);
-						content[name] = make_shared<BSONBufferNode>(buf, shared_from_this());
-					}
-						break;
-					default:
-						addString(name, elem.String());
-					}
-				}
+		steps.push_back(s);
+		if (end == string::npos) {
 			break;
-			case BSONType::jstOID:
-				content[name] = make_shared<BSONGUIDNode>(elem.__oid().str(), shared_from_this());
-				break;
+		}
+		start = end + 1;
+	}
+}
+
+bsonelement ofxBson::Path::getFieldDotted(const bsonobj & obj) const {
+	bsonobj at = obj;
+	bsonelement found;
+	for (auto& s : steps) {
+		if (!found.eoo()) {
+			if (!found.isObject()) {
+				return bsonelement();
 			}
-			
+			at = bsonobj(found.value());
+		}
+		found = at.getField(s.name);
+		if (found.eoo()) {
+			return found;
 		}
 	}
+	return found;
 }
 
-void ofxBson::BSONObjNode::addGUIDObject(const string & name, const string & guid, const string& type, bool & already_in_store) {
-	already_in_store = (bson->storedObjects.find(guid) != bson->storedObjects.cend());
-	content[name] = make_shared<BSONGUIDNode>(guid, type, shared_ptr<BSONNode>(this), bson);
+bool ofxBson::resolve(const Path & path) const {
+	const BSONDocument* d = doc.get();
+	if (path.doc == d && path.version == d->version) {
+		return path.node || path.array;
+	}
+	path.doc = d;
+	path.version = d->version;
+	path.node = 0;
+	path.array = 0;
+	path.held.reset();
+	shared_ptr<BSONNode> at = root;
+	for (auto& s : path.steps) {
+		if (at->isArray()) {
+			auto arr = at->getArray();
+			if (s.index == string::npos) {
+				return false;
+			}
+			if (arr->isPacked() && &s == &path.steps.back()) {
+				if (s.index >= arr->length()) {
+					return false;
+				}
+				path.array = arr.get();
+				path.index = s.index;
+				path.held = arr;
+				return true;
+			}
+			at = arr->getAt(s.index);
+		} else if (at->isObject() && at->getObject()) {
+			at = at->getObject()->getChild(s.name);
+		} else {
+			return false;
+		}
+		if (!at) {
+			return false;
+		}
+	}
+	path.node = at.get();
+	path.held = at;
+	return true;
 }
 
-inline bool ofxBson::BSONObjNode::exists(const string & name) const {
-	return (content.find(name) != content.cend());
+bool ofxBson::exists(const Path & path) const {
+	return resolve(path);
 }
 
-inline void ofxBson::BSONObjNode::constructInBuilder(bsonobjbuilder & b) const {
-	for (auto&item : content) {
-		if (item.second->isObject()) {
-			if (item.second->getObject()) {
-				string name = item.first;
-				bsonobjbuilder sub(b.subobjStart(name));
-				item.second->getObject()->constructInBuilder(sub);
-			}
-			else b.appendNull(item.first);
-		} else if (item.second->isArray()) {
-			if (item.second->getArray()) {
-				string name = item.first;
-				bsonobjbuilder arr(b.subarrayStart(name));
-				item.second->getArray()->constructInBuilder(arr);
-				arr.done();
-			}
-		} else if (item.second->isNull()) {
-			b.appendNull(item.first);
-		} else if (item.second->isBool()) {
-			b.appendBool(item.first, item.second->getBool());
-		} else if (item.second->isNumber()) {
-			b.appendNumber(item.first, item.second->getNumber());
-		} else if (item.second->isString()) {
-			b.append(item.first, item.second->getString());
-		} else if (item.second->isGUID()) {
-			boost::uuids::uuid uid = boost::lexical_cast<boost::uuids::uuid>(item.second->getGUID());
-			
-			b.appendBinData(item.first, uid.size(), BinDataType::newUUID, uid.data);
+bool ofxBson::setTo(const Path & path) {
+	if (!resolve(path) || !path.node) {
+		return false;
+	}
+	if (!path.node->isArray() && !path.node->getObject()) {
+		return false;
+	}
+	setRoot(root);
+	for (auto& s : path.steps) {
+		if (current->isArray() ? !setTo(s.index) : !setTo(s.name)) {
+			return false;
 		}
 	}
-	b.done();
+	return true;
 }
 
-inline bsonobj ofxBson::BSONObjNode::obj() const {
-	if (content.size() == 0) {
-		return bsonobj();
+int ofxBson::getIntValue(const Path & path) const {
+	if (!resolve(path)) {
+		return numeric_limits<int32_t>::min();
 	}
-	bsonobjbuilder b;
-	constructInBuilder(b);
-	return b.obj();
-}
-
-int ofxBson::getIntValue(const string & name) const {
-	return current->getObject()->getNumber(name);
+	return path.node ? path.node->getNumber() : path.array->getNumberAt(path.index);
 }
 
-float ofxBson::getFloatValue(const string & name) const {
-	return current->getObject()->getNumber(name);
+float ofxBson::getFloatValue(const Path & path) const {
+	return getDoubleValue(path);
 }
 
-double ofxBson::getDoubleValue(const string & name) const {
-	return current->getObject()->getNumber(name);
+double ofxBson::getDoubleValue(const Path & path) const {
+	if (!resolve(path)) {
+		return numeric_limits<double>::signaling_NaN();
+	}
+	return path.node ? path.node->getNumber() : path.array->getNumberAt(path.index);
 }
 
-bool ofxBson::getBoolValue(const string & name) const {
-	return current->getObject()->getBool(name);
+int64_t ofxBson::getInt64Value(const Path & path) const {
+	if (!resolve(path)) {
+		return numeric_limits<int64_t>::min();
+	}
+	return path.node ? path.node->getInt64() : path.array->getInt64At(path.index);
 }
 
-string ofxBson::getValue(const string & name) const {
-	return current->getObject()->getString(name);
+bool ofxBson::getBoolValue(const Path & path) const {
+	if (!resolve(path)) {
+		return false;
+	}
+	return path.node ? path.node->getBool() : path.array->getAt(path.index)->getBool();
 }
 
-string ofxBson::getGUID(const string & name) const {
-	return current->getObject()->getChild(name)->getGUID();
+string ofxBson::getValue(const Path & path) const {
+	if (!resolve(path)) {
+		return "";
+	}
+	return path.node ? path.node->getString() : path.array->getAt(path.index)->getString();
 }
 
-string ofxBson::getGUID(size_t index) const {
-	return current->getArray()->getAt(index)->getGUID();
-}
 
 
+size_t ofxBson::BSONArrayNode::pushGUIDObject(const ofxBsonUUID & guid, const string & type, bool &already_in_store) {
+	return push(bson->guidNode(guid, type, shared_from_this(), doc, already_in_store));
+}
 
-size_t ofxBson::BSONArrayNode::pushGUIDObject(const string & guid, bool &already_in_store) {
-	already_in_store = (bson->storedObjects.find(guid) != bson->storedObjects.cend());
-	return push(make_shared<BSONGUIDNode>(guid, "", shared_ptr<BSONNode>(this), bson));
+shared_ptr<ofxBson::BSONObjWithGUIDNode> ofxBson::BSONGUIDNode::getReference() const {
+	return bson ? bson->findObject(guid) : shared_ptr<BSONObjWithGUIDNode>();
 }
 
 shared_ptr<ofxBson::BSONObjNode> ofxBson::BSONGUIDNode::getObject() const {
-	return reference;
+	return getReference();
 }
 
 shared_ptr<void> ofxBson::BSONGUIDNode::getConstructedObject(ofxBson& b) const {
+	auto reference = b.findObject(guid);
 	if (reference) {
-		return reference->construct(b);
+		return b.store ? reference->getConstructed() : reference->construct(b);
 	} else {
 		return shared_ptr<void>();
 	}
 }
 
 shared_ptr<void> ofxBson::BSONObjWithGUIDNode::construct(ofxBson & b) {
-	if (!constructedObject) {
-		auto cons = b.constructors.find(type);
-		if (cons != b.constructors.cend()) {
-			constructedObject = cons->second(b);
-			return constructedObject;
+	if (!constructedObject && !constructing) {
+		auto& from = *(b.store ? b.store->constructors : b.constructors);
+		auto cons = from.find(type);
+		if (cons != from.cend()) {
+			constructing = true;
+			try {
+				constructedObject = cons->second(b);
+			} catch (...) {
+				constructing = false;
+				throw;
+			}
+			constructing = false;
+			constructed.store(!!constructedObject, std::memory_order_release);
 		}
-		return shared_ptr<void>();
-	} else {
-		return constructedObject;
 	}
+	return constructedObject;
 }
 
-ofxBson::BSONObjWithGUIDNode::BSONObjWithGUIDNode(const _bson::bsonobj & obj, weak_ptr<BSONNode> parent): BSONObjNode(obj, parent) {
-	int len = 0;
-	auto guid_c = obj.getField("%guid").binData(len);
-	guid = string(guid_c, len);
-	type = obj.getStringField("%type");
+void ofxBson::BSONObjWithGUIDNode::loadFrom(const _bson::bsonobj & obj, const shared_ptr<const void>& backing) {
+	static const char* names[] = { "%guid", "%type" };
+	bsonelement fields[2];
+	obj.getFields(2, names, fields);
+	guid = elementGUID(fields[0]);
+	type = fields[1].type() == String ? fields[1].valuestr() : "";
+	BSONObjNode::loadFrom(obj, backing);
+	content.erase("%guid");
+	content.erase("%type");
+	// loads may run on another thread: the ofxBson stores it when it next looks an object up
+	if (doc && !doc->frozen) {
+		doc->loadedObjects.push_back(static_pointer_cast<BSONObjWithGUIDNode>(shared_from_this()));
+	}
+}
+
+long long ofxBson::BSONObjWithGUIDNode::getSerializedSize() const {
+	// %guid as a binary uuid and %type as a string come first
+	return BSONObjNode::getSerializedSize() + (1 + 6 + 4 + 1 + ofxBsonUUID::Size) + (1 + 6 + 4 + (long long)type.size() + 1);
+}
+
+shared_ptr<ofxBson::BSONObjNode> ofxBson::BSONObjWithGUIDNode::copy(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const {
+	auto to = makeNode<BSONObjWithGUIDNode>(d, guid, type, parent, bson, d);
+	copyState(to);
+	to->constructedObject = constructedObject;
+	to->constructed.store(constructed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	return to;
+}
+
+shared_ptr<ofxBson::BSONObjNode> ofxBson::BSONObjWithGUIDNode::clone(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const {
+	auto copy = makeNode<BSONObjWithGUIDNode>(d, guid, type, parent, bson, d);
+	cloneContent(copy, d);
+	return copy;
+}
+
+bool ofxBson::BSONObjWithGUIDNode::lookUpObject(const ofxBsonUUID & guid, shared_ptr<BSONNode>& found, bsonobj & bytes, shared_ptr<const void>& buf) const {
+	if (this->guid == guid) {
+		found = const_pointer_cast<BSONObjNode>(shared_from_this());
+		return true;
+	}
+	return BSONObjNode::lookUpObject(guid, found, bytes, buf);
 }
 
 void ofxBson::BSONObjWithGUIDNode::constructInBuilder(_bson::bsonobjbuilder & b) const {
-	b.append("%guid", _bson::OID(guid));
+	b.appendBinData("%guid", ofxBsonUUID::Size, BinDataType::newUUID, guid.bytes);
 	b.append("%type", type);
 	ofxBson::BSONObjNode::constructInBuilder(b);
 }
+
+void ofxBson::BSONObjWithGUIDNode::constructInStream(ofxBsonStreamWriter & w) const {
+	w.appendBinData("%guid", ofxBsonUUID::Size, BinDataType::newUUID, guid.bytes);
+	w.append("%type", type);
+	ofxBson::BSONObjNode::constructInStream(w);
+}
+
+ofxBson::Cursor ofxBson::cursor() const {
+	Cursor c;
+	c.objects = storedObjects;
+	c.root = root;
+	Cursor::Position at;
+	if (c.enter(at, root)) {
+		c.path.push_back(at);
+	}
+	return c;
+}
+
+bool ofxBson::Cursor::enter(Position & to, const shared_ptr<BSONNode>& node) const {
+	if (node->isGUID() && !node->isObject()) {
+		// a reference: not looked up through the ofxBson, which stores what it finds
+		return enterReference(to, node->getUUID());
+	}
+	if (node->isArray()) {
+		auto a = node->getArray();
+		if (a->isLazy()) {
+			to.view = a->getView();
+			to.backing = a->getBacking();
+		} else {
+			to.node = a;
+		}
+		to.array = true;
+		return true;
+	}
+	auto o = node->getObject();
+	if (!o) {
+		return false;
+	}
+	if (o->isLazy()) {
+		to.view = o->getView();
+		to.backing = o->getBacking();
+	} else {
+		to.node = o;
+	}
+	to.array = false;
+	return true;
+}
+
+bool ofxBson::Cursor::enter(Position & to, const bsonelement & elem, const shared_ptr<const void>& backing) const {
+	if ((elem.type() == BinData || elem.type() == jstOID) && lazyIsGUID(elem)) {
+		return enterReference(to, elementGUID(elem));
+	}
+	if (elem.type() == Object || elem.type() == Array) {
+		to.view = elem.Obj();
+		to.backing = backing;
+		to.array = elem.type() == Array;
+		return true;
+	}
+	if (lazyIsPackedArray(elem)) {
+		// no view to read the values from in place: unpack them into a node of the cursor's own
+		to.node = nodeFromElement(elem, shared_ptr<BSONNode>(), 0, shared_ptr<BSONDocument>());
+		to.array = true;
+		return true;
+	}
+	return false;
+}
+
+bool ofxBson::Cursor::enterReference(Position & to, const ofxBsonUUID & guid) const {
+	auto stored = objects ? objects->find(guid) : 0;
+	if (stored) {
+		return enter(to, *stored);
+	}
+	shared_ptr<BSONNode> found;
+	bsonobj bytes;
+	shared_ptr<const void> buf;
+	if (!root || !root->lookUpObject(guid, found, bytes, buf)) {
+		return false;
+	}
+	if (found) {
+		return enter(to, found);
+	}
+	to.view = bytes;
+	to.backing = buf;
+	to.array = false;
+	return true;
+}
+
+ofxBson::Cursor::Value ofxBson::Cursor::get(const string & name) const {
+	Value v;
+	if (path.empty() || path.back().array) {
+		return v;
+	}
+	const Position& at = path.back();
+	if (at.node) {
+		v.node = at.node->getObject()->getChild(name);
+	} else {
+		v.elem = at.view.getField(name);
+	}
+	return v;
+}
+
+ofxBson::Cursor::Value ofxBson::Cursor::get(size_t index) const {
+	Value v;
+	if (path.empty() || !path.back().array) {
+		return v;
+	}
+	const Position& at = path.back();
+	if (at.node) {
+		v.node = at.node->getArray()->getAt(index);
+	} else {
+		bsonobjiterator it(at.view);
+		for (size_t i = 0; it.more(); i++) {
+			bsonelement e = it.next();
+			if (i == index) {
+				v.elem = e;
+				break;
+			}
+		}
+	}
+	return v;
+}
+
+shared_ptr<ofxBson::BSONNode> ofxBson::Cursor::nodeFor(const Value & v) {
+	if (v.node || v.elem.eoo()) {
+		return v.node;
+	}
+	return nodeFromElement(v.elem, shared_ptr<BSONNode>(), 0, shared_ptr<BSONDocument>());
+}
+
+bool ofxBson::Cursor::setTo(const string & name) {
+	if (path.empty()) {
+		return false;
+	}
+	Value v = get(name);
+	Position next;
+	if (v.node ? !enter(next, v.node) : !enter(next, v.elem, path.back().backing)) {
+		return false;
+	}
+	path.push_back(next);
+	return true;
+}
+
+bool ofxBson::Cursor::setTo(size_t index) {
+	if (path.empty()) {
+		return false;
+	}
+	Value v = get(index);
+	Position next;
+	if (v.node ? !enter(next, v.node) : !enter(next, v.elem, path.back().backing)) {
+		return false;
+	}
+	path.push_back(next);
+	return true;
+}
+
+void ofxBson::Cursor::setToParent() {
+	if (path.size() > 1) {
+		path.pop_back();
+	}
+}
+
+bool ofxBson::Cursor::isArray() const {
+	return !path.empty() && path.back().array;
+}
+
+size_t ofxBson::Cursor::getSize() const {
+	if (path.empty()) {
+		return 0;
+	}
+	const Position& at = path.back();
+	if (!at.node) {
+		return at.view.nFields();
+	}
+	return at.array ? at.node->getArray()->length() : at.node->getObject()->fieldCount();
+}
+
+bool ofxBson::Cursor::exists(const string & name) const {
+	Value v = get(name);
+	return v.node || !v.elem.eoo();
+}
+
+bool ofxBson::Cursor::exists(size_t index) const {
+	Value v = get(index);
+	return v.node || !v.elem.eoo();
+}
+
+int ofxBson::Cursor::getIntValue(const string & name) const {
+	return getDoubleValue(name);
+}
+
+int ofxBson::Cursor::getIntValue(size_t index) const {
+	return getDoubleValue(index);
+}
+
+float ofxBson::Cursor::getFloatValue(const string & name) const {
+	return getDoubleValue(name);
+}
+
+float ofxBson::Cursor::getFloatValue(size_t index) const {
+	return getDoubleValue(index);
+}
+
+double ofxBson::Cursor::getDoubleValue(const string & name) const {
+	Value v = get(name);
+	return v.node ? v.node->getNumber() : lazyNumber(v.elem);
+}
+
+double ofxBson::Cursor::getDoubleValue(size_t index) const {
+	Value v = get(index);
+	return v.node ? v.node->getNumber() : lazyNumber(v.elem);
+}
+
+int64_t ofxBson::Cursor::getInt64Value(const string & name) const {
+	Value v = get(name);
+	return v.node ? v.node->getInt64() : lazyInt64(v.elem);
+}
+
+int64_t ofxBson::Cursor::getInt64Value(size_t index) const {
+	Value v = get(index);
+	return v.node ? v.node->getInt64() : lazyInt64(v.elem);
+}
+
+bool ofxBson::Cursor::getBoolValue(const string & name) const {
+	Value v = get(name);
+	return v.node ? v.node->getBool() : lazyBool(v.elem);
+}
+
+bool ofxBson::Cursor::getBoolValue(size_t index) const {
+	Value v = get(index);
+	return v.node ? v.node->getBool() : lazyBool(v.elem);
+}
+
+string ofxBson::Cursor::getValue(const string & name) const {
+	Value v = get(name);
+	return v.node ? v.node->getString() : lazyString(v.elem);
+}
+
+string ofxBson::Cursor::getValue(size_t index) const {
+	Value v = get(index);
+	return v.node ? v.node->getString() : lazyString(v.elem);
+}
+
+string ofxBson::Cursor::getGUID(const string & name) const {
+	auto node = nodeFor(get(name));
+	return node ? node->getGUID() : "";
+}
+
+string ofxBson::Cursor::getGUID(size_t index) const {
+	auto node = nodeFor(get(index));
+	return node ? node->getGUID() : "";
+}
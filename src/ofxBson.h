@@ -1,8 +1,20 @@
 #pragma once
 
 #include "ofMain.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
 
 #include "bson/bsonobjbuilder.h"
+#include "bson/bsonobjiterator.h"
+#include "ofxBsonArena.h"
+#include "ofxBsonStreamWriter.h"
+#include "ofxBsonFieldMap.h"
+#include "ofxBsonUUIDMap.h"
+
+class ofxBsonThreadPool;
 
 class ofxBson: public ofBaseFileSerializer {
 protected:
@@ -10,14 +22,111 @@ protected:
 	class BSONObjNode;
 	class BSONGUIDNode;
 	class BSONObjWithGUIDNode;
+	class BSONNode;
+	struct ParallelSave;
+	struct Level;
+
+	// BinData subtypes of packed arrays saved as a single block (user defined range, opaque to other readers)
+	enum {
+		PackedDoubleBinData = _bson::bdtCustom + 1,
+		PackedInt32BinData,
+		PackedInt64BinData
+	};
+
+	/** state shared by every container node of one document tree.
+		kept apart from ofxBson itself so a tree can be built detached
+		from the document that will eventually own it.
+	*/
+	class BSONDocument {
+	public:
+		shared_ptr<ofxBsonArena> arena;
+		shared_ptr<ofxBsonKeyTable> keys;
+		/** containers keep the bytes of the last save and reuse them while they are clean */
+		bool cacheSerialized;
+		/** set while save() builds the document: containers note where their bytes start in the output */
+		vector<pair<BSONNode*, int>>* saved;
+		/** bumped whenever a node is added to, replaced in or removed from the tree; values
+			updated in place keep their node and leave it as it is. every document starts
+			from its own range, so a version is never seen twice, even at the same address.
+		*/
+		uint64_t version;
+		/** set when a snapshot took the tree: its containers are shared from then on, and
+			never modified again. the document being edited continues with a new BSONDocument
+			and modifies copies of them instead.
+		*/
+		bool frozen;
+		/** objects with a guid built from loaded bytes, for the store of the ofxBson to take in.
+			the tree may be parsed on another thread, so they are not stored right away.
+		*/
+		vector<weak_ptr<BSONObjWithGUIDNode>> loadedObjects;
+		/** set once every lazy container was read in to find the objects with a guid */
+		bool objectsScanned;
+		BSONDocument(bool useArena = false, size_t blockSize = ofxBsonArena::DefaultBlockSize):
+			keys(make_shared<ofxBsonKeyTable>()), cacheSerialized(false), saved(0), version(firstVersion()), frozen(false), objectsScanned(false) {
+			if (useArena) {
+				arena = make_shared<ofxBsonArena>(blockSize);
+			}
+		}
+		/** a document using the key table of another one */
+		explicit BSONDocument(const shared_ptr<ofxBsonKeyTable>& keys):
+			keys(keys), cacheSerialized(false), saved(0), version(firstVersion()), frozen(false), objectsScanned(false) {
+		}
+	private:
+		static uint64_t firstVersion() {
+			static std::atomic<uint64_t> documents(0);
+			return ++documents << 32;
+		}
+	};
+
+	/** allocates a node from the document's arena when it has one, from the heap otherwise */
+	template <typename T, typename... Args>
+	static shared_ptr<T> makeNode(const shared_ptr<BSONDocument>& doc, Args&&... args) {
+		if (doc && doc->arena) {
+			return allocate_shared<T>(ofxBsonArenaAllocator<T>(doc->arena), std::forward<Args>(args)...);
+		}
+		return make_shared<T>(std::forward<Args>(args)...);
+	}
+
 	class BSONNode {
 	public:
 		ofxBson* bson;
 		static ofBuffer emptyBuffer;
 		weak_ptr<BSONNode> parent;
 		weak_ptr<BSONNode> tempParent;
-		BSONNode(weak_ptr<BSONNode> parent = weak_ptr<BSONNode>(), ofxBson *bson = 0) : parent(parent), bson(bson) {}
+		/** changed since it was last saved (or loaded lazily); a dirty node always has dirty ancestors */
+		bool dirty;
+		BSONNode(weak_ptr<BSONNode> parent = weak_ptr<BSONNode>(), ofxBson *bson = 0) : bson(bson), parent(parent), dirty(true) {}
 		virtual ~BSONNode() {}
+		/** flags this node and its ancestors as changed and drops their computed sizes.
+			stops at the first ancestor that was already dirty with no size computed.
+			@param structural whether children were added, replaced or removed, rather
+			than only given new values
+		*/
+		void markDirty(bool structural = true) {
+			dirty = true;
+			forgetSize();
+			if (structural) {
+				structureChanged();
+			}
+			for (auto p = parent.lock(); p; p = p->parent.lock()) {
+				bool sized = p->forgetSize();
+				if (p->dirty && !sized) {
+					break;
+				}
+				p->dirty = true;
+			}
+		}
+		/** drops the memoized serialized size, if any. @return whether there was one */
+		virtual bool forgetSize() { return false; }
+		/** bumps the version of the document of a container whose children changed */
+		virtual void structureChanged() {}
+		/** a container of a frozen document, see BSONDocument::frozen. values never change anyway */
+		virtual bool isShared() const { return false; }
+		/** called by save() with the bytes just written for this node (empty when they can't be kept) */
+		virtual void setSaved(const _bson::bsonobj&, const shared_ptr<const void>&) { dirty = false; }
+		/** called by save() on the nodes under a container it copied as its cached bytes from,
+			now at offset in the output: containers among them note where their own bytes went */
+		virtual void noteCopied(const _bson::bsonobj&, int) {}
 		virtual bool isObject() const { return false; }
 		virtual bool isArray() const { return false; }
 		virtual bool isString() const { return false; }
@@ -42,6 +151,31 @@ protected:
 		virtual shared_ptr<BSONArrayNode> getArray() { return shared_ptr<BSONArrayNode>(); }
 		virtual shared_ptr<BSONObjNode> getObject() { return shared_ptr<BSONObjNode>(); }
 		virtual string getGUID() const { return ""; }
+		/** the guid as its bytes, nil when the node has none */
+		virtual ofxBsonUUID getUUID() const { return ofxBsonUUID(); }
+		/** materializes every lazy container below that is not shared, see ofxBson::constructAll() */
+		virtual void loadAll() {}
+		/** like loadAll(), but only for the lazy containers holding objects with a guid, see
+			ofxBson::storeAll()
+		*/
+		virtual void loadObjects() {}
+		/** looks for target among the nodes built below, adding the levels that lead to it
+			to steps, the deepest first. @return whether it was found
+		*/
+		virtual bool pathTo(const BSONNode*, vector<Level>&) const { return false; }
+		/** adds the paths, from this node down, to the lazy containers shared with a snapshot
+			that hold objects with a guid. at is the path to this node. see ofxBson::storeAll()
+		*/
+		virtual void sharedObjectHolders(vector<Level>&, vector<vector<Level>>&) const {}
+		/** looks for the object with guid below without building or storing anything: lazy
+			containers are read in place. found is its node, or else bytes holds it, inside
+			the buffer kept alive by buf. see ofxBson::Cursor
+		*/
+		virtual bool lookUpObject(const ofxBsonUUID&, shared_ptr<BSONNode>&, _bson::bsonobj&, shared_ptr<const void>&) const { return false; }
+		/** adds the guids of the references and objects with a guid below, without looking
+			inside those objects. see ofxBson::constructAll()
+		*/
+		virtual void references(vector<ofxBsonUUID>&) const {}
 		weak_ptr<BSONNode> getParent() {
 			if (tempParent.expired()) {
 				return parent;
@@ -72,6 +206,7 @@ protected:
 			BSONNode(parent), str(str) {}
 		bool isString() const { return true; }
 		virtual string getString() const { return str; }
+		void set(const string& value) { str = value; }
 	};
 	class BSONInt32Node : public BSONNode {
 	protected:
@@ -81,8 +216,10 @@ protected:
 			BSONNode(parent), n(n) {
 		}
 		bool isInt32() const { return true; }
+		double getNumber() const { return n; }
 		int32_t getInt32() const { return n; }
 		int64_t getInt64() const { return n; }
+		void set(int32_t value) { n = value; }
 	};
 	class BSONInt64Node : public BSONNode {
 	protected:
@@ -92,7 +229,9 @@ protected:
 			BSONNode(parent), n(n) {
 		}
 		bool isInt64() const { return true; }
+		double getNumber() const { return (double)n; }
 		int64_t getInt64() const { return n; }
+		void set(int64_t value) { n = value; }
 	};
 
 	class BSONNumberNode : public BSONNode {
@@ -103,6 +242,7 @@ protected:
 			BSONNode(parent), n(d) {}
 		bool isNumber() const { return true; }
 		double getNumber() const { return n; }
+		void set(double value) { n = value; }
 	};
 
 	class BSONBoolNode : public BSONNode {
@@ -113,6 +253,7 @@ protected:
 			BSONNode(parent), b(b) {}
 		bool isBool() const { return true; }
 		bool getBool() const { return b; }
+		void set(bool value) { b = value; }
 	};
 
 	class BSONBufferNode : public BSONNode {
@@ -130,144 +271,633 @@ protected:
 	class BSONArrayNode : public BSONNode, public enable_shared_from_this<BSONArrayNode> {
 	protected:
 		vector<shared_ptr<BSONNode>> items;
+		// lazy mode: the elements still live in 'view', inside a buffer kept alive by 'backing'.
+		// with BSONDocument::cacheSerialized the view is also kept once the items are built, and
+		// holds their serialized bytes for as long as the node is not dirty.
+		_bson::bsonobj view;
+		shared_ptr<const void> backing;
+		bool lazy;
+		int lazyLength;
+		// getSerializedSize() of the current content, -1 until computed. shared nodes
+		// can be sized from several threads
+		mutable std::atomic<long long> knownSize;
 	public:
-		BSONArrayNode(weak_ptr<BSONNode> parent = weak_ptr<BSONNode>(), ofxBson *bson = 0):BSONNode(parent, bson) {}
+		shared_ptr<BSONDocument> doc;
+		BSONArrayNode(weak_ptr<BSONNode> parent = weak_ptr<BSONNode>(), ofxBson *bson = 0, shared_ptr<BSONDocument> doc = shared_ptr<BSONDocument>()):
+			BSONNode(parent, bson), lazy(false), lazyLength(-1), knownSize(-1), doc(doc) {}
+		virtual void loadFrom(const _bson::bsonobj& obj, const shared_ptr<const void>& backing = shared_ptr<const void>());
+		/** wraps the elements of obj without building any child nodes until they are needed */
+		void setLazy(const _bson::bsonobj& obj, const shared_ptr<const void>& backing);
+		/** turns the wrapped elements into child nodes (one level deep); no-op if not lazy */
+		void materialize();
+		void loadAll();
+		void loadObjects();
+		bool pathTo(const BSONNode* target, vector<Level>& steps) const;
+		void sharedObjectHolders(vector<Level>& at, vector<vector<Level>>& paths) const;
+		bool lookUpObject(const ofxBsonUUID& guid, shared_ptr<BSONNode>& found, _bson::bsonobj& bytes, shared_ptr<const void>& buf) const;
+		void references(vector<ofxBsonUUID>& guids) const;
+		bool isLazy() const { return lazy; }
+		/** the wrapped elements while lazy, and the buffer they live in */
+		const _bson::bsonobj& getView() const { return view; }
+		const shared_ptr<const void>& getBacking() const { return backing; }
+		/** view holds the current bytes of the array, so it can be written out as it is */
+		bool isCached() const { return lazy || (!dirty && backing); }
+		void setSaved(const _bson::bsonobj& bytes, const shared_ptr<const void>& buf) {
+			if (buf) {
+				view = bytes;
+				backing = buf;
+			}
+			dirty = false;
+		}
+		void noteCopied(const _bson::bsonobj& from, int offset);
+		bool forgetSize() {
+			bool known = knownSize >= 0;
+			knownSize = -1;
+			return known;
+		}
+		void structureChanged() {
+			if (doc) {
+				doc->version++;
+			}
+		}
+		bool isShared() const { return doc && doc->frozen; }
+		/** bytes the array takes once serialized, size prefix and terminator included.
+			computed once and kept until the array or one of its children changes.
+		*/
+		virtual long long getSerializedSize() const;
+		/** false for arrays that keep their values unboxed, see BSONPackedArray */
+		virtual bool isPacked() const { return false; }
 		bool isArray() const { return true; }
 		shared_ptr<BSONArrayNode> getArray() { return shared_from_this(); }
-		void constructInBuilder(_bson::bsonobjbuilder &builder) {
-			int c = 0;
-			for (auto& item : items) {
-				if (item->isNull()) {
-					builder.appendNull(ofToString(c));
-				} else if (item->isBool()) {
-					builder.appendBool(ofToString(c), item->getBool());
-				} else if (item->isNumber()) {
-					builder.appendNumber(ofToString(c), item->getNumber());
-				} else if (item->isInt32()) {
-					builder.appendIntOrLL(ofToString(c), item->getInt32());
-				} else if (item->isInt64()) {
-					builder.append(ofToString(c), item->getInt64());
-				} else if (item->isBuffer()) {
-					builder.appendBinData(ofToString(c), item->getBuffer().size(), _bson::BinDataType::BinDataGeneral, item->getBuffer().getBinaryBuffer());
-				} else if (item->isString()) {
-					builder.append(ofToString(c), item->getString());
-				} else if (item->isArray()) {
-					_bson::bsonobjbuilder b(builder.subarrayStart(ofToString(c)));
-					item->getArray()->constructInBuilder(b);
-					b._done();
-				} else if (item->isObject()) {
-					_bson::bsonobjbuilder b(builder.subobjStart(ofToString(c)));
-					item->getObject()->constructInBuilder(b);
-					b._done();
-				} else if (item->isGUID()) {
-					builder.append(ofToString(c), _bson::OID(item->getGUID()));
-				}
-				c++;
+		virtual void constructInBuilder(_bson::bsonarraybuilder &builder);
+		virtual void constructInStream(ofxBsonStreamWriter &w) const;
+		/** writes the array at 'at' (getSerializedSize() bytes), handing big children to the pool of job */
+		virtual void writeParallel(ParallelSave& job, char* at) const;
+		/** packed arrays to be saved as one BinData block fill these in and return true */
+		virtual bool getPackedBinData(const void*&, int&, _bson::BinDataType&) const { return false; }
+		virtual size_t length() const;
+		virtual shared_ptr<BSONNode> getAt(size_t i) const {
+			if (lazy && isShared()) {
+				return detachedAt(i);
 			}
-		}
-		size_t length() const { return items.size(); }
-		shared_ptr<BSONNode> getAt(size_t i) const {
-			if (i < length()) {
+			const_cast<BSONArrayNode*>(this)->materialize();
+			if (i < items.size()) {
 				return items[i];
 			} else {
 				return shared_ptr<BSONNode>();
 			}
 		}
-		size_t push(shared_ptr<BSONNode> node) {
+		virtual double getNumberAt(size_t i) const {
+			auto item = getAt(i);
+			return item ? item->getNumber() : numeric_limits<double>::signaling_NaN();
+		}
+		virtual int32_t getInt32At(size_t i) const {
+			auto item = getAt(i);
+			return item ? item->getInt32() : numeric_limits<int32_t>::min();
+		}
+		virtual int64_t getInt64At(size_t i) const {
+			auto item = getAt(i);
+			return item ? item->getInt64() : numeric_limits<int64_t>::min();
+		}
+		/** copies up to count elements starting at offset. @return the number of elements copied */
+		virtual size_t getValues(double* out, size_t count, size_t offset = 0) const;
+		virtual size_t getValues(int32_t* out, size_t count, size_t offset = 0) const;
+		virtual size_t getValues(int64_t* out, size_t count, size_t offset = 0) const;
+
+		virtual size_t push(shared_ptr<BSONNode> node) {
+			materialize();
 			items.push_back(node);
+			markDirty();
 			return items.size() - 1;
 		}
+		/** appends count elements. @return the index of the first one */
+		virtual size_t pushValues(const double* values, size_t count);
+		virtual size_t pushValues(const int32_t* values, size_t count);
+		virtual size_t pushValues(const int64_t* values, size_t count);
 
 		size_t pushNull() {
-			return push(make_shared<BSONNullNode>(shared_from_this()));
+			return push(makeNode<BSONNullNode>(doc, shared_from_this()));
 		}
 		size_t pushBool(bool b) {
-			return push(make_shared<BSONBoolNode>(b, shared_from_this()));
+			return push(makeNode<BSONBoolNode>(doc, b, shared_from_this()));
 		}
-		size_t pushNumber(double d) {
-			return push(make_shared<BSONNumberNode>(d, shared_from_this()));
+		virtual size_t pushNumber(double d) {
+			return push(makeNode<BSONNumberNode>(doc, d, shared_from_this()));
 		}
-		size_t pushInt32(int32_t i) {
-			return push(make_shared<BSONInt32Node>(i, shared_from_this()));
+		virtual size_t pushInt32(int32_t i) {
+			return push(makeNode<BSONInt32Node>(doc, i, shared_from_this()));
 		}
-		size_t pushInt64(int64_t i) {
-			return push(make_shared<BSONInt64Node>(i, shared_from_this()));
+		virtual size_t pushInt64(int64_t i) {
+			return push(makeNode<BSONInt64Node>(doc, i, shared_from_this()));
 		}
 		size_t pushString(const string& str) {
-			return push(make_shared<BSONStringNode>(str, shared_from_this()));
+			return push(makeNode<BSONStringNode>(doc, str, shared_from_this()));
 		}
 		size_t pushNewObject() {
-			return push(make_shared<BSONObjNode>(shared_from_this()));
+			return push(makeNode<BSONObjNode>(doc, shared_from_this(), bson, doc));
 		}
 		size_t pushNewArray() {
-			return push(make_shared<BSONArrayNode>(shared_from_this()));
+			return push(makeNode<BSONArrayNode>(doc, shared_from_this(), bson, doc));
 		}
 		size_t pushBuffer(const ofBuffer& buf) {
-			return push(make_shared<BSONBufferNode>(buf, shared_from_this()));
+			return push(makeNode<BSONBufferNode>(doc, buf, shared_from_this()));
+		}
+		/** see ofxBson::pushGUIDObject() */
+		size_t pushGUIDObject(const ofxBsonUUID& guid, const string& type, bool& already_in_store);
+		/** a detached copy to be written out elsewhere. objects and arrays are copied, values are
+			shared (they never change once created) and cached parts only keep their bytes.
+		*/
+		virtual shared_ptr<BSONArrayNode> clone(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const;
+		/** a copy of this array alone, sharing its elements, to be modified in its place */
+		virtual shared_ptr<BSONArrayNode> copy(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const;
+		/** puts node at i instead of an element with the same content */
+		void replaceAt(size_t i, const shared_ptr<BSONNode>& node) {
+			items[i] = node;
+			structureChanged();
+		}
+	protected:
+		void cloneItems(const shared_ptr<BSONArrayNode>& copy, const shared_ptr<BSONDocument>& d) const;
+		void copyState(const shared_ptr<BSONArrayNode>& to) const;
+		// shared lazy arrays are never materialized: their elements are read into nodes of their own
+		shared_ptr<BSONNode> detachedAt(size_t i) const;
+		template <typename T>
+		size_t detachedValues(T* out, size_t count, size_t offset, T (*read)(const _bson::bsonelement&)) const;
+		void noteSaved(int offset) {
+			if (doc && doc->saved) {
+				doc->saved->push_back(make_pair((BSONNode*)this, offset));
+			}
 		}
-		size_t pushGUIDObject(const string& guid, bool& already_in_store);
 	};
+
+	/** array of numbers kept unboxed in one contiguous vector instead of a node per element.
+		it reads and saves like any other array of T; pushing anything that is not a T
+		turns it back into a regular array of nodes first.
+		with binary set it is saved as a single BinData block (raw host order values)
+		instead of a BSON array, and read back by ofxBson as a packed array again.
+	*/
+	template <typename T>
+	class BSONPackedArray : public BSONArrayNode {
+	protected:
+		vector<T> values;
+		bool packed;
+		bool binary;
+	public:
+		BSONPackedArray(weak_ptr<BSONNode> parent = weak_ptr<BSONNode>(), ofxBson *bson = 0, shared_ptr<BSONDocument> doc = shared_ptr<BSONDocument>(), bool binary = false):
+			BSONArrayNode(parent, bson, doc), packed(true), binary(binary) {}
+		/** false once it fell back to a regular array */
+		bool isPacked() const { return packed; }
+		bool isBinary() const { return binary; }
+		void setBinary(bool b) {
+			if (binary != b) {
+				binary = b;
+				markDirty();
+			}
+		}
+
+		void loadFrom(const _bson::bsonobj& obj, const shared_ptr<const void>& backing = shared_ptr<const void>()) {
+			if (packed) {
+				values.reserve(obj.nFields());
+				for (_bson::bsonelement elem : obj) {
+					T v;
+					if (!readElement(elem, v)) {
+						// mixed types: keep the whole array as nodes
+						unpack();
+						items.clear();
+						break;
+					}
+					values.push_back(v);
+				}
+				if (packed) {
+					return;
+				}
+			}
+			BSONArrayNode::loadFrom(obj, backing);
+		}
+		/** takes the values of a BinData block written by getPackedBinData(); false if the size does not fit */
+		bool loadBinData(const char* data, int len) {
+			if (len < 0 || len % sizeof(T) != 0) {
+				return false;
+			}
+			values.resize(len / sizeof(T));
+			if (len > 0) {
+				memcpy(&values[0], data, len);
+			}
+			binary = true;
+			return true;
+		}
+		bool getPackedBinData(const void*& data, int& len, _bson::BinDataType& type) const {
+			if (!packed || !binary) {
+				return false;
+			}
+			data = values.data();
+			len = (int)(values.size() * sizeof(T));
+			type = binDataType((T)0);
+			return true;
+		}
+
+		size_t length() const {
+			return packed ? values.size() : BSONArrayNode::length();
+		}
+		/** elements have no node of their own: a detached node holding a copy of the value is returned */
+		shared_ptr<BSONNode> getAt(size_t i) const {
+			if (!packed) {
+				return BSONArrayNode::getAt(i);
+			}
+			if (i >= values.size()) {
+				return shared_ptr<BSONNode>();
+			}
+			return nodeFor(values[i], shared_ptr<BSONDocument>(), const_cast<BSONPackedArray*>(this)->shared_from_this());
+		}
+		double getNumberAt(size_t i) const {
+			if (!packed) {
+				return BSONArrayNode::getNumberAt(i);
+			}
+			return i < values.size() ? (double)values[i] : numeric_limits<double>::signaling_NaN();
+		}
+		int32_t getInt32At(size_t i) const {
+			if (!packed) {
+				return BSONArrayNode::getInt32At(i);
+			}
+			// same answers as the BSONInt32Node/BSONInt64Node/BSONNumberNode the element would be
+			return i < values.size() && is_same<T, int32_t>::value ? (int32_t)values[i] : numeric_limits<int32_t>::min();
+		}
+		int64_t getInt64At(size_t i) const {
+			if (!packed) {
+				return BSONArrayNode::getInt64At(i);
+			}
+			return i < values.size() && !is_same<T, double>::value ? (int64_t)values[i] : numeric_limits<int64_t>::min();
+		}
+		size_t getValues(double* out, size_t count, size_t offset = 0) const { return packedGet(out, count, offset); }
+		size_t getValues(int32_t* out, size_t count, size_t offset = 0) const { return packedGet(out, count, offset); }
+		size_t getValues(int64_t* out, size_t count, size_t offset = 0) const { return packedGet(out, count, offset); }
+
+		size_t push(shared_ptr<BSONNode> node) {
+			unpack();
+			return BSONArrayNode::push(node);
+		}
+		size_t pushNumber(double d) { return packedPush(&d, 1); }
+		size_t pushInt32(int32_t i) { return packedPush(&i, 1); }
+		size_t pushInt64(int64_t i) { return packedPush(&i, 1); }
+		size_t pushValues(const double* src, size_t count) { return packedPush(src, count); }
+		size_t pushValues(const int32_t* src, size_t count) { return packedPush(src, count); }
+		size_t pushValues(const int64_t* src, size_t count) { return packedPush(src, count); }
+
+		void constructInBuilder(_bson::bsonarraybuilder &builder) {
+			if (!packed) {
+				BSONArrayNode::constructInBuilder(builder);
+				return;
+			}
+			noteSaved(builder.len() - 4);
+			if (isCached()) {
+				builder.appendElements(view);
+				return;
+			}
+			for (auto v : values) {
+				appendValue(builder, v);
+			}
+		}
+		long long getSerializedSize() const {
+			if (!packed) {
+				return BSONArrayNode::getSerializedSize();
+			}
+			if (isCached()) {
+				return view.objsize();
+			}
+			if (knownSize < 0) {
+				// type byte and value per element, plus their keys
+				knownSize = 4 + 1 + (long long)values.size() * (1 + sizeof(T)) + _bson::bsonarraybuilder::indexKeysSize((unsigned)values.size());
+			}
+			return knownSize;
+		}
+		void constructInStream(ofxBsonStreamWriter &w) const {
+			if (!packed) {
+				BSONArrayNode::constructInStream(w);
+				return;
+			}
+			if (isCached()) {
+				w.appendElements(view);
+				return;
+			}
+			char name[12];
+			for (size_t i = 0; i < values.size(); i++) {
+				_bson::bsonarraybuilder::formatIndex((unsigned)i, name);
+				appendValue(w, name, values[i]);
+			}
+		}
+
+		shared_ptr<BSONArrayNode> clone(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const {
+			auto copy = makeNode<BSONPackedArray>(d, parent, bson, d, binary);
+			if (packed) {
+				copy->values = values;
+			} else {
+				copy->packed = false;
+				cloneItems(copy, d);
+			}
+			return copy;
+		}
+		shared_ptr<BSONArrayNode> copy(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const {
+			auto to = makeNode<BSONPackedArray>(d, parent, bson, d, binary);
+			copyState(to);
+			to->values = values;
+			to->packed = packed;
+			return to;
+		}
+
+	protected:
+		/** moves the values into regular nodes; the array behaves like a plain BSONArrayNode from then on */
+		void unpack() {
+			if (!packed) {
+				return;
+			}
+			packed = false;
+			auto self = shared_from_this();
+			items.reserve(items.size() + values.size());
+			for (auto v : values) {
+				items.push_back(nodeFor(v, doc, self));
+			}
+			vector<T>().swap(values);
+		}
+
+		size_t packedPush(const T* src, size_t count) {
+			if (!packed) {
+				return BSONArrayNode::pushValues(src, count);
+			}
+			size_t first = values.size();
+			values.insert(values.end(), src, src + count);
+			markDirty();
+			return first;
+		}
+		template <typename U>
+		size_t packedPush(const U* src, size_t count) {
+			unpack();
+			return BSONArrayNode::pushValues(src, count);
+		}
+
+		size_t packedGet(T* out, size_t count, size_t offset) const {
+			if (!packed) {
+				return BSONArrayNode::getValues(out, count, offset);
+			}
+			if (offset >= values.size()) {
+				return 0;
+			}
+			count = std::min(count, values.size() - offset);
+			memcpy(out, &values[offset], count * sizeof(T));
+			return count;
+		}
+		template <typename U>
+		size_t packedGet(U* out, size_t count, size_t offset) const {
+			return BSONArrayNode::getValues(out, count, offset);
+		}
+
+		static shared_ptr<BSONNode> nodeFor(double v, const shared_ptr<BSONDocument>& doc, weak_ptr<BSONNode> parent) {
+			return makeNode<BSONNumberNode>(doc, v, parent);
+		}
+		static shared_ptr<BSONNode> nodeFor(int32_t v, const shared_ptr<BSONDocument>& doc, weak_ptr<BSONNode> parent) {
+			return makeNode<BSONInt32Node>(doc, v, parent);
+		}
+		static shared_ptr<BSONNode> nodeFor(int64_t v, const shared_ptr<BSONDocument>& doc, weak_ptr<BSONNode> parent) {
+			return makeNode<BSONInt64Node>(doc, v, parent);
+		}
+
+		static bool readElement(const _bson::bsonelement& e, double& v) {
+			if (e.type() != _bson::NumberDouble) return false;
+			v = e._numberDouble();
+			return true;
+		}
+		static bool readElement(const _bson::bsonelement& e, int32_t& v) {
+			if (e.type() != _bson::NumberInt) return false;
+			v = e._numberInt();
+			return true;
+		}
+		static bool readElement(const _bson::bsonelement& e, int64_t& v) {
+			if (e.type() != _bson::NumberLong) return false;
+			v = e._numberLong();
+			return true;
+		}
+
+		static void appendValue(_bson::bsonarraybuilder& b, double v) { b.append(v); }
+		static void appendValue(_bson::bsonarraybuilder& b, int32_t v) { b.append((int)v); }
+		static void appendValue(_bson::bsonarraybuilder& b, int64_t v) { b.append((long long)v); }
+		static void appendValue(ofxBsonStreamWriter& w, const char* name, double v) { w.appendNumber(name, v); }
+		static void appendValue(ofxBsonStreamWriter& w, const char* name, int32_t v) { w.append(name, (int)v); }
+		static void appendValue(ofxBsonStreamWriter& w, const char* name, int64_t v) { w.append(name, (long long)v); }
+
+		static _bson::BinDataType binDataType(double) { return (_bson::BinDataType)PackedDoubleBinData; }
+		static _bson::BinDataType binDataType(int32_t) { return (_bson::BinDataType)PackedInt32BinData; }
+		static _bson::BinDataType binDataType(int64_t) { return (_bson::BinDataType)PackedInt64BinData; }
+	};
+	typedef BSONPackedArray<double> BSONPackedDoubleArray;
+	typedef BSONPackedArray<int32_t> BSONPackedInt32Array;
+	typedef BSONPackedArray<int64_t> BSONPackedInt64Array;
 	class BSONObjNode: public BSONNode, public enable_shared_from_this<BSONObjNode> {
 	protected:
-		map<string, shared_ptr<BSONNode>> content;
+		ofxBsonFieldMap<shared_ptr<BSONNode>> content;
 		string type;
+		// lazy mode: the fields still live in 'view', inside a buffer kept alive by 'backing'.
+		// with BSONDocument::cacheSerialized the view is also kept once the fields are built, and
+		// holds their serialized bytes for as long as the node is not dirty.
+		_bson::bsonobj view;
+		shared_ptr<const void> backing;
+		bool lazy;
+		// getSerializedSize() of the current content, -1 until computed, see BSONArrayNode
+		mutable std::atomic<long long> knownSize;
+		// what the last obj() returned points into
+		mutable shared_ptr<ofBuffer> objBytes;
 	public:
-		BSONObjNode() {}
-		BSONObjNode(weak_ptr<BSONNode> parent, ofxBson *bson = 0): BSONNode(parent, bson) {}
-		BSONObjNode(const _bson::bsonobj& obj, weak_ptr<BSONNode> _parent = weak_ptr<BSONNode>());
+		shared_ptr<BSONDocument> doc;
+		BSONObjNode(): lazy(false), knownSize(-1) {}
+		BSONObjNode(weak_ptr<BSONNode> parent, ofxBson *bson = 0, shared_ptr<BSONDocument> doc = shared_ptr<BSONDocument>()):
+			BSONNode(parent, bson), lazy(false), knownSize(-1), doc(doc) {}
+		/** populates the node from a parsed object. must be called once the node is owned by a shared_ptr.
+			when a backing buffer is given, sub-objects and arrays are left lazy over it.
+		*/
+		virtual void loadFrom(const _bson::bsonobj& obj, const shared_ptr<const void>& backing = shared_ptr<const void>());
+		/** wraps the fields of obj without building any child nodes until they are needed */
+		void setLazy(const _bson::bsonobj& obj, const shared_ptr<const void>& backing);
+		/** turns the wrapped fields into child nodes (one level deep); no-op if not lazy */
+		void materialize();
+		void loadAll();
+		void loadObjects();
+		bool pathTo(const BSONNode* target, vector<Level>& steps) const;
+		void sharedObjectHolders(vector<Level>& at, vector<vector<Level>>& paths) const;
+		bool lookUpObject(const ofxBsonUUID& guid, shared_ptr<BSONNode>& found, _bson::bsonobj& bytes, shared_ptr<const void>& buf) const;
+		void references(vector<ofxBsonUUID>& guids) const;
+		bool isLazy() const { return lazy; }
+		/** the wrapped fields while lazy, and the buffer they live in */
+		const _bson::bsonobj& getView() const { return view; }
+		const shared_ptr<const void>& getBacking() const { return backing; }
+		size_t fieldCount() const { return lazy ? view.nFields() : content.size(); }
+		/** view holds the current bytes of the object, so it can be written out as it is */
+		bool isCached() const { return lazy || (!dirty && backing); }
+		virtual void setSaved(const _bson::bsonobj& bytes, const shared_ptr<const void>& buf) {
+			if (buf) {
+				view = bytes;
+				backing = buf;
+			}
+			dirty = false;
+		}
+		void noteCopied(const _bson::bsonobj& from, int offset);
+		bool forgetSize() {
+			bool known = knownSize >= 0;
+			knownSize = -1;
+			return known;
+		}
+		void structureChanged() {
+			if (doc) {
+				doc->version++;
+			}
+		}
+		bool isShared() const { return doc && doc->frozen; }
+		/** bytes the object takes once serialized, see BSONArrayNode::getSerializedSize() */
+		virtual long long getSerializedSize() const;
+		bool isObject() const { return true; }
+		/** the document's interned key for a field name */
+		const ofxBsonKey* keyFor(const char* name, size_t len) {
+			if (!doc) {
+				doc = make_shared<BSONDocument>();
+			}
+			return doc->keys->intern(name, len);
+		}
+		const ofxBsonKey* keyFor(const string& name) { return keyFor(name.data(), name.size()); }
+		/** the value under key if it is a T that can be set in place: the paths that lead
+			to it stay valid. leaves are shared with the copies of the object a snapshot
+			led to, and those still have the original object as parent: replaced instead
+		*/
+		template <typename T>
+		T* ownLeaf(const ofxBsonKey* key) {
+			auto found = content.find(key);
+			if (found == content.end() || typeid(*found->second) != typeid(T) || found->second->parent.lock().get() != this) {
+				return 0;
+			}
+			return static_cast<T*>(found->second.get());
+		}
 		virtual void addChild(const string& name) {
-			content[name] = make_shared<BSONObjNode>(shared_from_this(), bson);
+			materialize();
+			content[keyFor(name)] = makeNode<BSONObjNode>(doc, shared_from_this(), bson, doc);
+			markDirty();
 		}
 		virtual void addNull(const string& name) {
-			content[name] = make_shared<BSONNullNode>(shared_from_this());
+			materialize();
+			content[keyFor(name)] = makeNode<BSONNullNode>(doc, shared_from_this());
+			markDirty();
 		}
 		virtual void addString(const string& name, const string& value) {
-			content[name] = make_shared<BSONStringNode>(value, shared_from_this());
+			materialize();
+			const ofxBsonKey* key = keyFor(name);
+			if (auto leaf = ownLeaf<BSONStringNode>(key)) {
+				leaf->set(value);
+				markDirty(false);
+				return;
+			}
+			content[key] = makeNode<BSONStringNode>(doc, value, shared_from_this());
+			markDirty();
 		}
 		virtual void addNumber(const string& name, double value) {
-			content[name] = make_shared<BSONNumberNode>(value, shared_from_this());
+			materialize();
+			const ofxBsonKey* key = keyFor(name);
+			if (auto leaf = ownLeaf<BSONNumberNode>(key)) {
+				leaf->set(value);
+				markDirty(false);
+				return;
+			}
+			content[key] = makeNode<BSONNumberNode>(doc, value, shared_from_this());
+			markDirty();
 		}
 		virtual void addInt32(const string& name, int32_t value) {
-			content[name] = make_shared<BSONInt32Node>(value, shared_from_this());
+			materialize();
+			const ofxBsonKey* key = keyFor(name);
+			if (auto leaf = ownLeaf<BSONInt32Node>(key)) {
+				leaf->set(value);
+				markDirty(false);
+				return;
+			}
+			content[key] = makeNode<BSONInt32Node>(doc, value, shared_from_this());
+			markDirty();
 		}
 		virtual void addInt64(const string& name, int64_t value) {
-			content[name] = make_shared<BSONInt64Node>(value, shared_from_this());
+			materialize();
+			const ofxBsonKey* key = keyFor(name);
+			if (auto leaf = ownLeaf<BSONInt64Node>(key)) {
+				leaf->set(value);
+				markDirty(false);
+				return;
+			}
+			content[key] = makeNode<BSONInt64Node>(doc, value, shared_from_this());
+			markDirty();
 		}
 		virtual void addBool(const string& name, bool value) {
-			content[name] = make_shared<BSONBoolNode>(value, shared_from_this());
+			materialize();
+			const ofxBsonKey* key = keyFor(name);
+			if (auto leaf = ownLeaf<BSONBoolNode>(key)) {
+				leaf->set(value);
+				markDirty(false);
+				return;
+			}
+			content[key] = makeNode<BSONBoolNode>(doc, value, shared_from_this());
+			markDirty();
 		}
 		virtual void addBuffer(const string& name, const ofBuffer& buf) {
-			content[name] = make_shared<BSONBufferNode>(buf, shared_from_this());
+			materialize();
+			content[keyFor(name)] = makeNode<BSONBufferNode>(doc, buf, shared_from_this());
+			markDirty();
 		}
 		virtual void addArray(const string& name) {
-			content[name] = make_shared<BSONArrayNode>(shared_from_this(), bson);
+			materialize();
+			content[keyFor(name)] = makeNode<BSONArrayNode>(doc, shared_from_this(), bson, doc);
+			markDirty();
+		}
+		virtual void addDoubleArray(const string& name, bool binary) {
+			materialize();
+			content[keyFor(name)] = makeNode<BSONPackedDoubleArray>(doc, shared_from_this(), bson, doc, binary);
+			markDirty();
+		}
+		virtual void addInt32Array(const string& name, bool binary) {
+			materialize();
+			content[keyFor(name)] = makeNode<BSONPackedInt32Array>(doc, shared_from_this(), bson, doc, binary);
+			markDirty();
+		}
+		virtual void addInt64Array(const string& name, bool binary) {
+			materialize();
+			content[keyFor(name)] = makeNode<BSONPackedInt64Array>(doc, shared_from_this(), bson, doc, binary);
+			markDirty();
 		}
 
-		virtual void addGUIDObject(const string& name, const string& guid, const string& type, bool& already_in_store);
+		/** see ofxBson::setGUIDObject() */
+		virtual void addGUIDObject(const string& name, const ofxBsonUUID& guid, const string& type, bool& already_in_store);
 
 		virtual bool exists(const string& name) const;
 		virtual shared_ptr<BSONNode> getChild(const string& name) const {
-			return content.find(name)->second;
+			if (lazy && isShared()) {
+				return detachedChild(view.getField(name));
+			}
+			const_cast<BSONObjNode*>(this)->materialize();
+			auto found = content.find(name);
+			return found != content.cend() ? found->second : shared_ptr<BSONNode>();
 		}
 		virtual shared_ptr<BSONObjNode> getObject() {
 			return shared_from_this();
 		}
 		virtual double getNumber(const string& name) const {
+			if (lazy) return lazyNumber(view.getField(name));
 			return getChild(name)->getNumber();
 		}
 		virtual int32_t getInt32(const string& name) const {
+			if (lazy) return lazyInt32(view.getField(name));
 			return getChild(name)->getInt32();
 		}
 		virtual int64_t getInt64(const string& name) const {
+			if (lazy) return lazyInt64(view.getField(name));
 			return getChild(name)->getInt64();
 		}
 		virtual const ofBuffer& getBuffer(const string& name) const {
 			return getChild(name)->getBuffer();
 		}
 		virtual bool getBool(const string& name) const {
+			if (lazy) return lazyBool(view.getField(name));
 			return getChild(name)->getBool();
 		}
 		virtual string getString(const string& name) const {
+			if (lazy) return lazyString(view.getField(name));
 			return getChild(name)->getString();
 		}
 		virtual shared_ptr<BSONArrayNode> getArray(const string& name) const {
@@ -278,114 +908,551 @@ protected:
 		}
 		
 		virtual bool isChild(const string& name) const {
+			if (lazy) return view.hasField(name);
 			return (content.find(name) != content.cend());
 		}
 		virtual bool isNull(const string& name) const {
-			return isChild(name) && getChild(name)->isNull();
+			if (lazy) return lazyIsNull(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isNull();
 		}
 		virtual bool isBool(const string& name) const {
-			return isChild(name) && getChild(name)->isBool();
+			if (lazy) return lazyIsBool(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isBool();
 		}
 		virtual bool isNumber(const string& name) const {
-			return isChild(name) && getChild(name)->isNumber();
+			if (lazy) return lazyIsNumber(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isNumber();
 		}
 		virtual bool isInt32(const string& name) const {
-			return isChild(name) && getChild(name)->isInt32();
+			if (lazy) return lazyIsInt32(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isInt32();
 		}
 		virtual bool isInt64(const string& name) const {
-			return isChild(name) && getChild(name)->isInt64();
+			if (lazy) return lazyIsInt64(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isInt64();
 		}
 		virtual bool isBuffer(const string& name) const {
-			return isChild(name) && getChild(name)->isBuffer();
+			if (lazy) return lazyIsBuffer(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isBuffer();
 		}
 		virtual bool isString(const string& name) const {
-			return isChild(name) && getChild(name)->isString();;
+			if (lazy) return lazyIsString(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isString();
 		}
 		virtual bool isObject(const string& name) const {
-			return isChild(name) && getChild(name)->isObject();
+			if (lazy) return lazyIsObject(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isObject();
 		}
 		virtual bool isArray(const string& name) const {
-			return isChild(name) && getChild(name)->isArray();
+			if (lazy) return lazyIsArray(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isArray();
 		}
 		virtual bool isGUID(const string& name) const {
-			return isChild(name) && getChild(name)->isGUID();
+			if (lazy) return lazyIsGUID(view.getField(name));
+			auto child = getChild(name);
+			return child && child->isGUID();
 		}
 		
 		virtual void constructInBuilder(_bson::bsonobjbuilder &b) const;
+		virtual void constructInStream(ofxBsonStreamWriter &w) const;
+		/** writes the object at 'at' (getSerializedSize() bytes), handing big children to the pool of job */
+		virtual void writeParallel(ParallelSave& job, char* at) const;
+		/** the object serialized, built at its exact size in a single allocation. the bytes stay
+			valid until the next call or until the node goes away.
+		*/
 		_bson::bsonobj obj() const;
+		/** a detached copy to be written out elsewhere, see BSONArrayNode::clone() */
+		virtual shared_ptr<BSONObjNode> clone(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const;
+		/** a copy of this object alone, sharing its children, to be modified in its place */
+		virtual shared_ptr<BSONObjNode> copy(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const;
+		/** puts node in the field name instead of a child with the same content */
+		void replaceChild(const string& name, const shared_ptr<BSONNode>& node) {
+			content[keyFor(name)] = node;
+			structureChanged();
+		}
+	protected:
+		void cloneContent(const shared_ptr<BSONObjNode>& copy, const shared_ptr<BSONDocument>& d) const;
+		void copyState(const shared_ptr<BSONObjNode>& to) const;
+		// see BSONArrayNode::detachedAt()
+		shared_ptr<BSONNode> detachedChild(const _bson::bsonelement& elem) const;
 	};
 
 	class BSONObjWithGUIDNode : public BSONObjNode {
 	public:
-		string guid;
+		ofxBsonUUID guid;
 		string type;
 		shared_ptr<void> constructedObject;
+		// set while its constructor runs: asking for it then, from a cycle, gives null
+		bool constructing;
+		// set once constructedObject holds the object, which is never replaced afterwards.
+		// constructAll() constructs objects on several threads: the others only read
+		// constructedObject once this says it is there
+		std::atomic<bool> constructed;
 		shared_ptr<void> construct(ofxBson& b);
-		BSONObjWithGUIDNode(const string& guid, const string& type, weak_ptr<BSONNode> parent, ofxBson *bson):
-			BSONObjNode(parent, bson), guid(guid), type(type) {}
-		BSONObjWithGUIDNode(const _bson::bsonobj & obj, weak_ptr<BSONNode> parent);
+		/** the constructed object, or null if it is not done yet. safe while another thread constructs it */
+		shared_ptr<void> getConstructed() const {
+			return constructed.load(std::memory_order_acquire) ? constructedObject : shared_ptr<void>();
+		}
+		BSONObjWithGUIDNode(const ofxBsonUUID& guid, const string& type, weak_ptr<BSONNode> parent, ofxBson *bson, shared_ptr<BSONDocument> doc = shared_ptr<BSONDocument>()):
+			BSONObjNode(parent, bson, doc), guid(guid), type(type), constructing(false), constructed(false) {}
+		BSONObjWithGUIDNode(weak_ptr<BSONNode> parent, ofxBson *bson, shared_ptr<BSONDocument> doc):
+			BSONObjNode(parent, bson, doc), constructing(false), constructed(false) {}
+		void loadFrom(const _bson::bsonobj& obj, const shared_ptr<const void>& backing = shared_ptr<const void>());
 		void constructInBuilder(_bson::bsonobjbuilder &b) const;
+		void constructInStream(ofxBsonStreamWriter &w) const;
+		// the saved bytes include %guid and %type, which are not fields of the node: never reused
+		void setSaved(const _bson::bsonobj&, const shared_ptr<const void>&) { dirty = false; }
+		long long getSerializedSize() const;
+		shared_ptr<BSONObjNode> clone(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const;
+		shared_ptr<BSONObjNode> copy(weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d) const;
 		bool isGUID() const { return true; }
-		string getGUID() const { return guid; }
+		string getGUID() const { return guid.str(); }
+		ofxBsonUUID getUUID() const { return guid; }
+		bool lookUpObject(const ofxBsonUUID& guid, shared_ptr<BSONNode>& found, _bson::bsonobj& bytes, shared_ptr<const void>& buf) const;
 	};
 public:
 	typedef function<shared_ptr<void>(ofxBson&)> constructor_fn;
+	typedef function<void(ofxBson&, const shared_ptr<void>&)> linker_fn;
 protected:
+	/** a reference to an object with a guid stored elsewhere in the document. it is saved as
+		the guid alone, and stands for the object when entered or modified.
+	*/
 	class BSONGUIDNode : public BSONObjNode {
 	public:
-		shared_ptr<BSONObjWithGUIDNode> reference;
+		ofxBsonUUID guid;
 
-		BSONGUIDNode(const string& guid, const string& type, weak_ptr<BSONNode> parent = weak_ptr<BSONNode>(), ofxBson *bson = 0):
-			BSONObjNode(parent, bson) {
-			auto found = bson->storedObjects.find(guid);
-			if (found == bson->storedObjects.cend()) {
-			//	bson->storedObjects[guid] = make_shared<BSONObjWithGUIDNode>(guid, type, parent, bson);
-			} else {
-				reference = found->second;
-			}
-		}
-		BSONGUIDNode(const string& guid, weak_ptr<BSONNode> parent = weak_ptr<BSONNode>()):
-			BSONObjNode(parent, bson) {
-			
-		}
+		BSONGUIDNode(const ofxBsonUUID& guid, weak_ptr<BSONNode> parent = weak_ptr<BSONNode>(), ofxBson *bson = 0):
+			BSONObjNode(parent, bson), guid(guid) {}
+		/** the object referred to, looked up in the store of the ofxBson each time (the object
+			may have been replaced by a copy since); null if it is not known there
+		*/
+		shared_ptr<BSONObjWithGUIDNode> getReference() const;
+		bool isGUID() const { return true; }
+		// saved as a guid, not as an object
+		bool isObject() const { return false; }
+		string getGUID() const { return guid.str(); }
+		ofxBsonUUID getUUID() const { return guid; }
 		shared_ptr<BSONObjNode> getObject() const;
 		shared_ptr<void> getConstructedObject(ofxBson& b) const;
-		virtual void addChild(const string& name) { reference->addChild(name); }
-		virtual void addNull(const string& name) { reference->addNull(name); }
-		virtual void addString(const string& name, const string& value) { reference->addString(name, value); }
-		virtual void addNumber(const string& name, double value) { reference->addNumber(name, value); }
-		virtual void addInt32(const string& name, int32_t value) { reference->addInt32(name, value); }
-		virtual void addInt64(const string& name, int64_t value) { reference->addInt64(name, value); }
-		virtual void addBool(const string& name, bool value) { reference->addBool(name, value); }
-		virtual void addBuffer(const string& name, const ofBuffer& buf) { reference->addBuffer(name, buf); }
-		virtual void addArray(const string& name) { reference->addArray(name); }
+		virtual void addChild(const string& name) { if (auto r = getReference()) r->addChild(name); }
+		virtual void addNull(const string& name) { if (auto r = getReference()) r->addNull(name); }
+		virtual void addString(const string& name, const string& value) { if (auto r = getReference()) r->addString(name, value); }
+		virtual void addNumber(const string& name, double value) { if (auto r = getReference()) r->addNumber(name, value); }
+		virtual void addInt32(const string& name, int32_t value) { if (auto r = getReference()) r->addInt32(name, value); }
+		virtual void addInt64(const string& name, int64_t value) { if (auto r = getReference()) r->addInt64(name, value); }
+		virtual void addBool(const string& name, bool value) { if (auto r = getReference()) r->addBool(name, value); }
+		virtual void addBuffer(const string& name, const ofBuffer& buf) { if (auto r = getReference()) r->addBuffer(name, buf); }
+		virtual void addArray(const string& name) { if (auto r = getReference()) r->addArray(name); }
+		virtual void addDoubleArray(const string& name, bool binary) { if (auto r = getReference()) r->addDoubleArray(name, binary); }
+		virtual void addInt32Array(const string& name, bool binary) { if (auto r = getReference()) r->addInt32Array(name, binary); }
+		virtual void addInt64Array(const string& name, bool binary) { if (auto r = getReference()) r->addInt64Array(name, binary); }
 
-		virtual void addGUIDObject(const string& name, const string& guid, const string& type, bool& already_in_store) {
-			reference->addGUIDObject(name, guid, type, already_in_store);
+		virtual void addGUIDObject(const string& name, const ofxBsonUUID& guid, const string& type, bool& already_in_store) {
+			if (auto r = getReference()) r->addGUIDObject(name, guid, type, already_in_store);
 		}
 
 		virtual bool exists(const string& name) const {
-			return reference->exists(name);
+			auto r = getReference();
+			return r && r->exists(name);
 		}
 		virtual shared_ptr<BSONNode> getChild(const string& name) const {
-			return reference->getChild(name);
+			auto r = getReference();
+			return r ? r->getChild(name) : shared_ptr<BSONNode>();
 		}
 		virtual shared_ptr<BSONObjNode> getObject() {
 			return shared_from_this();
 		}
 		virtual bool isChild(const string& name) const {
-			return reference->isChild(name);
+			auto r = getReference();
+			return r && r->isChild(name);
 		}
 	};
 
-	map<string, constructor_fn> constructors;
-	map<string, shared_ptr<BSONObjWithGUIDNode>> storedObjects;
+	shared_ptr<BSONDocument> newDocument() const;
+	static shared_ptr<BSONObjNode> parseRoot(ofxBson* bson, const _bson::bsonobj& obj, const shared_ptr<const void>& backing, const shared_ptr<BSONDocument>& d, bool lazy);
+	void loadRoot(const _bson::bsonobj& obj, const shared_ptr<const void>& backing);
+	static shared_ptr<BSONNode> cloneChild(const shared_ptr<BSONNode>& child, weak_ptr<BSONNode> parent, const shared_ptr<BSONDocument>& d);
+	bool saveIncremental(const string& path);
+	bool saveParallel(const string& path);
+	/** writes the document, of getSerializedSize() bytes, at out, the way save() would */
+	bool saveInto(char* out, long long size);
+	bool saveParallel(char* out, long long size);
+	/** builds the document as saveIncremental() does, into o, whose bytes the cache keeps.
+		buf holds them too, for when nothing is cached (e.g. all the nodes belong to a frozen document)
+	*/
+	bool saveCached(_bson::bsonobj& o, shared_ptr<const void>& buf);
+	/** how each kind of node is serialized, in one place: picks what the value of node is
+		written as and hands it to the matching method of e, which appends it to a builder
+		or a stream, or counts its bytes. nodes that are not written give e.skip()
+	*/
+	template <typename Encoder>
+	static typename Encoder::Result encodeValue(Encoder& e, const shared_ptr<BSONNode>& node);
+	struct FieldBuilder;
+	struct ElementBuilder;
+	struct StreamEncoder;
+	struct ValueSize;
+	/** writes one field (object) or element (array) through a stream writer. @return false if the node is not written */
+	static bool streamValue(ofxBsonStreamWriter& w, const _bson::StringData& name, const shared_ptr<BSONNode>& node);
+	/** bytes the value of node takes once written, without its type and name; -1 if it is not written */
+	static long long valueSize(const shared_ptr<BSONNode>& node);
+	static shared_ptr<BSONNode> nodeFromElement(const _bson::bsonelement& elem, const shared_ptr<BSONNode>& parent, ofxBson* bson, const shared_ptr<BSONDocument>& doc, const shared_ptr<const void>& backing = shared_ptr<const void>());
+
+	// element readers used by lazy nodes; they mirror what the node built from the element would answer
+	static double lazyNumber(const _bson::bsonelement& e);
+	static int32_t lazyInt32(const _bson::bsonelement& e);
+	static int64_t lazyInt64(const _bson::bsonelement& e);
+	static bool lazyBool(const _bson::bsonelement& e);
+	static string lazyString(const _bson::bsonelement& e);
+	static bool lazyIsNull(const _bson::bsonelement& e) { return e.type() == _bson::jstNULL; }
+	static bool lazyIsBool(const _bson::bsonelement& e) { return e.type() == _bson::Bool; }
+	static bool lazyIsNumber(const _bson::bsonelement& e) { return e.type() == _bson::NumberDouble; }
+	static bool lazyIsInt32(const _bson::bsonelement& e) { return e.type() == _bson::NumberInt; }
+	static bool lazyIsInt64(const _bson::bsonelement& e) { return e.type() == _bson::NumberLong; }
+	static bool lazyIsBuffer(const _bson::bsonelement& e);
+	static bool lazyIsString(const _bson::bsonelement& e) { return e.type() == _bson::String; }
+	static bool lazyIsObject(const _bson::bsonelement& e) { return e.type() == _bson::Object; }
+	static bool lazyIsArray(const _bson::bsonelement& e) { return e.type() == _bson::Array || lazyIsPackedArray(e); }
+	static bool lazyIsPackedArray(const _bson::bsonelement& e);
+	static bool lazyIsGUID(const _bson::bsonelement& e);
+	/** the guid a binary uuid or an ObjectId (what older files saved guids as) holds, the 12
+		bytes of the latter padded with zeros. nil for anything else
+	*/
+	static ofxBsonUUID elementGUID(const _bson::bsonelement& e);
+	/** BSONNode::references() over serialized bytes */
+	static void lazyReferences(const _bson::bsonobj& obj, vector<ofxBsonUUID>& guids);
+	/** whether there is an object with a guid anywhere in obj */
+	static bool lazyHasObjects(const _bson::bsonobj& obj);
+	/** BSONNode::lookUpObject() over serialized bytes: found holds the object with guid, %guid and %type included */
+	static bool lazyFindObject(const _bson::bsonobj& obj, const ofxBsonUUID& guid, _bson::bsonobj& found);
+
+	/** a document parsed by loadAsync(), waiting for the main thread to swap it in */
+	struct AsyncLoad {
+		shared_ptr<BSONDocument> doc;
+		shared_ptr<BSONObjNode> root;
+		promise<bool> done;
+	};
+	/** shared with the worker thread, so it outlives the ofxBson if it is still running.
+		loads and saves are queued and run one after the other, in the order they were
+		asked for: two saves to the same file can't interleave, and a load after a save
+		reads what was saved
+	*/
+	struct AsyncState {
+		AsyncState() : working(false), poolThreads(0) {}
+		mutex lock;
+		deque<shared_ptr<AsyncLoad>> finished;
+		deque<function<void()>> jobs;
+		/** whether a worker thread is running; it ends once the queue is empty */
+		bool working;
+		/** the pool of the parallel saves run by the worker */
+		shared_ptr<ofxBsonThreadPool> pool;
+		size_t poolThreads;
+	};
+	/** queues job for the worker of state, starting one if none is running */
+	static void runAsync(const shared_ptr<AsyncState>& state, function<void()> job);
+	shared_ptr<AsyncState> async;
+	int pendingLoads;
+	void onUpdate(ofEventArgs& args);
+
+	/** shared with the snapshots: setConstructor() replaces the map instead of modifying it */
+	shared_ptr<const map<string, constructor_fn>> constructors;
+	map<string, linker_fn> linkers;
+	typedef ofxBsonUUIDMap<shared_ptr<BSONObjWithGUIDNode>> ObjectStore;
+	/** objects with a guid, by guid. references are resolved through it. shared with the
+		snapshots taken since it last changed, so it is only modified through storeForWriting()
+	*/
+	shared_ptr<ObjectStore> storedObjects;
+	/** the store, copied first if a snapshot shares it */
+	ObjectStore& storeForWriting();
+	/** set on the views constructAll() hands to constructors: objects and constructors are
+		looked up in this ofxBson instead
+	*/
+	ofxBson* store;
+	/** takes in the objects the current document loaded since the last call */
+	void storeLoaded();
+	/** takes in every object of the document, reading in the lazy containers that hold some.
+		the ones shared with a snapshot are never read in: they are copied first, like for
+		a modification
+	*/
+	void storeAll();
+	shared_ptr<BSONObjWithGUIDNode> findObject(const ofxBsonUUID& guid);
+	/** a new object registered under guid, or a reference if there is one already */
+	shared_ptr<BSONNode> guidNode(const ofxBsonUUID& guid, const string& type, const shared_ptr<BSONNode>& parent, const shared_ptr<BSONDocument>& d, bool& already_in_store);
+	bool useArena;
+	size_t arenaBlockSize;
+	bool lazyLoad;
+	bool incrementalSave;
+	bool parallelSave;
+	size_t saveThreads;
+	shared_ptr<ofxBsonThreadPool> savePool;
+	shared_ptr<BSONDocument> doc;
 	shared_ptr<BSONNode> root;
 	shared_ptr<BSONNode> current;
+	/** the nodes from the root down to current, and the field or index each was entered by.
+		nodes shared with a snapshot don't know their parent in this tree, so setToParent()
+		and copying the path on write follow this instead.
+	*/
+	struct Level {
+		shared_ptr<BSONNode> node;
+		string name;
+		size_t index;
+		/** entered through a reference: node is the object stored for guid, wherever it is */
+		bool reference;
+		ofxBsonUUID guid;
+		Level(): index(string::npos), reference(false) {}
+	};
+	vector<Level> levels;
+	/** set on snapshots: they ignore every modification */
+	bool readOnly;
+	void setRoot(const shared_ptr<BSONNode>& node);
+	void descend(const shared_ptr<BSONNode>& node, const string& name, size_t index);
+	/** enters the object a reference stands for, if it is known */
+	bool descendReference(const shared_ptr<BSONNode>& ref, const string& name, size_t index);
+	/** makes current and the nodes above it safe to modify: the ones shared with a snapshot
+		are replaced by copies, from the root down. false on a snapshot.
+	*/
+	bool own();
+	/** the same for the levels of path, see own() */
+	bool own(vector<Level>& path);
+	/** points level i of path at the node the tree holds there now, the levels above being up to date */
+	bool refetch(vector<Level>& path, size_t i);
+	/** makes the stored object for guid safe to modify, copying it and the nodes above it
+		in place if they are shared. finding where it is takes a walk through the tree
+	*/
+	bool ownObject(const ofxBsonUUID& guid);
+	/** hands the whole tree over to be shared, and goes on with a new document */
+	void freeze();
+	/** a read-only view of the tree at root, sharing the store and constructors of from. see snapshot() */
+	ofxBson(const ofxBson& from, const shared_ptr<BSONNode>& root);
 	friend class BSONObjWithGUIDNode;
 
 public:
-	ofxBson(): root(make_shared<BSONObjNode>()), current(root) {}
+	/** a dotted path from the root, like "scene.layers.3.material.color", split once.
+		numeric parts index arrays, and name fields in objects.
+		the nodes a path leads to are cached in it and reused for as long as the
+		structure of the document stays the same, so reading through it again is
+		a version check and a pointer dereference. a path caches one resolution:
+		don't share one between threads.
+	*/
+	class Path {
+	public:
+		Path() : doc(0), version(0), node(0), array(0), index(0) {}
+		explicit Path(const string& dotted);
+		const string& str() const { return dotted; }
+		/** like bsonobj::getFieldDotted(), without parsing the path again. eoo if not found */
+		_bson::bsonelement getFieldDotted(const _bson::bsonobj& obj) const;
+	private:
+		friend class ofxBson;
+		struct Step {
+			string name;
+			// the name as an array index, npos if it is not a number
+			size_t index;
+		};
+		string dotted;
+		vector<Step> steps;
+		// the last resolution and the document version it holds for. values of packed
+		// arrays have no node of their own: they are read from array at index instead
+		mutable const BSONDocument* doc;
+		mutable uint64_t version;
+		mutable BSONNode* node;
+		mutable BSONArrayNode* array;
+		mutable size_t index;
+		// keeps whichever of the two alive, for nodes read out of a shared lazy object
+		mutable shared_ptr<BSONNode> held;
+	};
+
+	/** a position in the document of its own, with the same reading interface as ofxBson.
+		any number of cursors can walk the same document, and read-only use of them is
+		safe from several threads at once as long as the document is not modified
+		meanwhile: a cursor never builds nodes for the lazily loaded parts it enters,
+		it reads their bytes in place instead. it keeps the parts it is in alive,
+		but does not follow later changes to the structure above them.
+		references are entered as the objects they stand for, whether they were loaded
+		as nodes or are still bytes; looking those up doesn't modify the document either.
+	*/
+	class Cursor {
+	public:
+		Cursor() {}
+		bool setTo(const string& name);
+		bool setTo(size_t index);
+		/** goes back to where the last setTo() came from; stops at the starting position */
+		void setToParent();
+		bool isArray() const;
+		/** elements of the current array, or fields of the current object */
+		size_t getSize() const;
+
+		bool exists(const string& name) const;
+		bool exists(size_t index) const;
+		int getIntValue(const string& name) const;
+		int getIntValue(size_t index) const;
+		float getFloatValue(const string& name) const;
+		float getFloatValue(size_t index) const;
+		double getDoubleValue(const string& name) const;
+		double getDoubleValue(size_t index) const;
+		int64_t getInt64Value(const string& name) const;
+		int64_t getInt64Value(size_t index) const;
+		bool getBoolValue(const string& name) const;
+		bool getBoolValue(size_t index) const;
+		string getValue(const string& name) const;
+		string getValue(size_t index) const;
+		string getGUID(const string& name) const;
+		string getGUID(size_t index) const;
+	private:
+		friend class ofxBson;
+		struct Position {
+			// the object or array, when it is made of nodes
+			shared_ptr<BSONNode> node;
+			// otherwise its bytes, in the buffer kept alive by backing
+			_bson::bsonobj view;
+			shared_ptr<const void> backing;
+			bool array;
+		};
+		// a child of the current position: a node, or an element of the bytes
+		struct Value {
+			shared_ptr<BSONNode> node;
+			_bson::bsonelement elem;
+		};
+		bool enter(Position& to, const shared_ptr<BSONNode>& node) const;
+		bool enter(Position& to, const _bson::bsonelement& elem, const shared_ptr<const void>& backing) const;
+		/** enters the object with guid: the one stored for it, or else the one in the tree */
+		bool enterReference(Position& to, const ofxBsonUUID& guid) const;
+		Value get(const string& name) const;
+		Value get(size_t index) const;
+		static shared_ptr<BSONNode> nodeFor(const Value& v);
+		vector<Position> path;
+		// where references are looked up: the store of the document when the cursor was
+		// made, then the tree, for the objects loaded since or still in lazy containers
+		shared_ptr<const ObjectStore> objects;
+		shared_ptr<BSONNode> root;
+	};
+	/** a cursor on the root of the document */
+	Cursor cursor() const;
+
+protected:
+	/** resolves path from the root, unless its cached resolution is still current */
+	bool resolve(const Path& path) const;
+
+public:
+	explicit ofxBson(bool useArena = false):
+		async(make_shared<AsyncState>()), pendingLoads(0),
+		constructors(make_shared<map<string, constructor_fn>>()), storedObjects(make_shared<ObjectStore>()), store(0),
+		useArena(useArena), arenaBlockSize(ofxBsonArena::DefaultBlockSize), lazyLoad(false), incrementalSave(false),
+		parallelSave(false), saveThreads(0),
+		doc(make_shared<BSONDocument>(useArena)),
+		root(makeNode<BSONObjNode>(doc, weak_ptr<BSONNode>(), this, doc)), readOnly(false) {
+		setRoot(root);
+	}
+	~ofxBson();
+
+	/** allocate the nodes of each document from contiguous arena blocks instead of one
+		heap allocation per node. applies to nodes created from now on and to every
+		document loaded afterwards. nodes replaced or removed leave their memory to the
+		next nodes of the same size; the blocks are released at once on teardown.
+	*/
+	void setUseArena(bool useArena, size_t blockSize = ofxBsonArena::DefaultBlockSize);
+	bool isUsingArena() const { return useArena; }
+	/** the arena backing the current document, or null when nodes come from the heap */
+	shared_ptr<const ofxBsonArena> getArena() const { return doc->arena; }
+
+	/** keep the loaded buffer and read fields straight from it. objects and arrays are
+		only turned into nodes when they are modified or entered with setTo().
+	*/
+	void setLazyLoad(bool lazy) { lazyLoad = lazy; }
+	bool isLazyLoad() const { return lazyLoad; }
+
+	/** keep the bytes written by save() in memory and copy them verbatim for every object
+		and array that did not change since, so only the modified paths are rebuilt. the
+		document is then built in memory before being written, instead of streamed.
+		a lazily loaded document also reuses the loaded bytes of untouched parts.
+	*/
+	void setIncrementalSave(bool incremental);
+	bool isIncrementalSave() const { return incrementalSave; }
+
+	/** serialize on several cores when saving. the size of every object and array is
+		computed first (and kept until it changes), then big subtrees are written
+		concurrently, each straight into its own slice of one output buffer, by a
+		work-stealing thread pool. the file is the same, byte for byte, as a serial save.
+		incremental save takes precedence when both are on.
+		@param threads workers of the pool, 0 for one per hardware thread
+	*/
+	void setParallelSave(bool parallel, size_t threads = 0);
+	bool isParallelSave() const { return parallelSave; }
+
+	/** exact size in bytes of the document as save() writes it, without writing anything.
+		sizes are kept per object and array and only recomputed along the paths that
+		changed, so asking again after a small edit is cheap.
+	*/
+	long long getSerializedSize() const;
+
+	/** like load(), but maps the file read-only instead of reading it into memory.
+		in lazy mode the document reads straight from the mapping, which stays alive
+		as long as any node refers to it; otherwise the tree is built from the
+		mapping and the mapping is dropped. saving over the mapped file is fine: saves
+		write to a temporary file that replaces the target only once it is complete.
+		the file is validated like load() does, except in lazy mode: then only its size
+		is checked up front, and the rest is trusted to be the bson ofxBson wrote. use
+		load() for files that may come from elsewhere.
+	*/
+	bool loadMapped(const string & path);
+
+	/** what loadFromBuffer() does with the bytes it is given */
+	enum Ownership {
+		/** copies them: they can be reused as soon as the call returns */
+		CopyBuffer,
+		/** reads them in place. in lazy mode they must stay valid and unchanged until another
+			document is loaded and no snapshot of this one is left; otherwise only during the call
+		*/
+		BorrowBuffer,
+		/** reads them in place, and frees them with delete[] once nothing refers to them.
+			they are taken even when loading fails
+		*/
+		AdoptBuffer
+	};
+	/** like load(), from size bytes in memory (e.g. received from a socket). the bytes are
+		validated first, so malformed input is rejected instead of read out of bounds
+	*/
+	bool loadFromBuffer(const char* data, size_t size, Ownership ownership = CopyBuffer);
+	/** writes the document to memory as save() would to a file, in the same mode. the
+		destination is resized to the exact size, so its capacity is reused from one call to the next
+	*/
+	bool saveToBuffer(ofBuffer& buf);
+	bool saveTo(vector<char>& out);
+
+	/** reads and parses the file on a worker thread into a separate tree, which replaces
+		the current one on the main thread at the next update of the app (or the next
+		applyAsyncLoads() call). the future becomes ready once the new tree is in place,
+		so don't wait on it from the main thread; poll it instead.
+		the tree keeps being usable, unchanged, until then.
+	*/
+	std::future<bool> loadAsync(const string & path);
+	/** writes the tree out on a worker thread, as save() would with the current settings.
+		nothing is copied here: the worker saves a snapshot() of the tree, and the tree can
+		be modified freely while the file is written. the file is replaced once complete.
+	*/
+	std::future<bool> saveAsync(const string & path);
+	/** a read-only view of the document as it is now, taken in constant time. the view and
+		the document share their nodes: the next modification of the document copies the
+		objects and arrays on the way from the root to the one modified, and leaves the
+		rest shared. cheap enough to take every frame, for rendering or autosaving from
+		another thread.
+		the view reads, saves and hands out cursors like any ofxBson; modifications of it
+		are ignored. the document keeps being used from one thread as before, while the
+		view is read from another; several threads reading the same view at once should
+		each use a cursor() of it.
+	*/
+	shared_ptr<ofxBson> snapshot();
+	/** swaps in the documents loadAsync() finished parsing. it is hooked to ofEvents().update
+		while loads are pending; call it yourself when there is no app loop running.
+	*/
+	void applyAsyncLoads();
 
 	bool exists(const string& name) const;
 	bool exists(size_t index) const;
@@ -393,6 +1460,15 @@ public:
 	size_t addChildToArray();
 	void addArray(const string& name);
 	size_t addArrayToArray();
+	/** adds an array that keeps its numbers in one contiguous block instead of a node per
+		element, for sensor logs, mesh attributes and the like. it is read and written
+		like any other array; pushing a value of another type turns it into a regular one.
+		@param binary save it as a single typed BinData block instead of a BSON array.
+		smaller and faster, but only ofxBson reads it back as an array.
+	*/
+	void addDoubleArray(const string& name, bool binary = false);
+	void addInt32Array(const string& name, bool binary = false);
+	void addInt64Array(const string& name, bool binary = false);
 	bool setTo(const string& name);
 	bool setTo(size_t index);
 	void setToParent();
@@ -412,11 +1488,28 @@ public:
 	size_t pushArray();
 	void setBuffer(const string& name, const ofBuffer& value);
 	size_t pushBuffer(const ofBuffer& buf);
+	/** appends count values to the current array. @return the index of the first one */
+	size_t pushValues(const double* values, size_t count);
+	size_t pushValues(const int32_t* values, size_t count);
+	size_t pushValues(const int64_t* values, size_t count);
+	/** copies up to count values of the current array, starting at offset. @return the number copied */
+	size_t getValues(double* values, size_t count, size_t offset = 0) const;
+	size_t getValues(int32_t* values, size_t count, size_t offset = 0) const;
+	size_t getValues(int64_t* values, size_t count, size_t offset = 0) const;
 
+	/** sets name to the object with this guid. the first time a guid is given, a new empty
+		object of the type is added, to be filled in; after that (already_in_store is then
+		true), a reference to that object is added instead, saved as the guid alone.
+		guids are given as text ("xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx") or as their bytes;
+		text that is not a guid adds nothing.
+	*/
 	void setGUIDObject(const string& name, const string& guid, bool& already_in_store);
 	void setGUIDObject(const string& name, const string& guid, const string& type, bool& already_in_store);
+	void setGUIDObject(const string& name, const ofxBsonUUID& guid, const string& type, bool& already_in_store);
+	/** the same, appended to the current array. @return its index */
 	size_t pushGUIDObject(const string& guid, bool& already_in_store);
 	size_t pushGUIDObject(const string& guid, const string& type, bool& already_in_store);
+	size_t pushGUIDObject(const ofxBsonUUID& guid, const string& type, bool& already_in_store);
 
 	size_t getSize() const;
 
@@ -435,27 +1528,71 @@ public:
 
 	string getGUID(const string& name) const;
 	string getGUID(size_t index) const;
+	/** the guid as its bytes, without making its text. nil if the value has none */
+	ofxBsonUUID getUUID(const string& name) const;
+	ofxBsonUUID getUUID(size_t index) const;
+
+	// the same, for a value anywhere in the document
+	bool exists(const Path& path) const;
+	/** makes the object or array at path the current one */
+	bool setTo(const Path& path);
+	int getIntValue(const Path& path) const;
+	float getFloatValue(const Path& path) const;
+	double getDoubleValue(const Path& path) const;
+	int64_t getInt64Value(const Path& path) const;
+	bool getBoolValue(const Path& path) const;
+	string getValue(const Path& path) const;
 
 	void setConstructor(const string& type_name, constructor_fn fn) {
-		constructors[type_name] = fn;
+		auto changed = make_shared<map<string, constructor_fn>>(*constructors);
+		(*changed)[type_name] = fn;
+		constructors = changed;
 	}
+	/** called by constructAll() on every object of the type it constructed, once all of them
+		exist, to take the references a cycle left unresolved
+	*/
+	void setLinker(const string& type_name, linker_fn fn) {
+		linkers[type_name] = fn;
+	}
+	/** constructs every stored object not constructed yet, on the workers of parallel saves
+		(see setParallelSave()). objects are constructed after the ones they refer to, and the
+		ones that don't depend on each other at the same time. the objects of a cycle are
+		constructed one after the other, and get null when asking for one that is not done
+		yet: their linkers fill those in afterwards.
+		each constructor is given a read only view of the document entered at its object, so
+		it must only look up the objects its fields refer to.
+		a constructor or linker that throws leaves its object unconstructed, and the others
+		run all the same: the first exception is thrown again once they are done.
+		@return the number of objects that have a constructed object
+	*/
+	size_t constructAll();
 	
 	
 	template <typename T>
-	shared_ptr<T> getConstructedObjectByGUID(const string& guid) {
-		auto found = storedObjects.find(guid);
-		if (found != storedObjects.cend()) {
-			if (!found->second->constructedObject) {
-				return static_pointer_cast<T>(found->second->construct(*this));
+	shared_ptr<T> getConstructedObjectByGUID(const ofxBsonUUID& guid) {
+		auto found = findObject(guid);
+		if (found) {
+			// the views of constructAll() only get what is constructed already, maybe by another worker
+			if (store) {
+				return static_pointer_cast<T>(found->getConstructed());
 			}
-			return static_pointer_cast<T>(found->second->constructedObject);
+			return static_pointer_cast<T>(found->construct(*this));
 		}
 		return shared_ptr<T>();
 	}
+	template<typename T>
+	shared_ptr<T> getConstructedObjectByGUID(const string& guid) {
+		ofxBsonUUID parsed;
+		if (!ofxBsonUUID::parse(guid, parsed)) {
+			return shared_ptr<T>();
+		}
+		return getConstructedObjectByGUID<T>(parsed);
+	}
 
 
 	virtual void serialize(const ofAbstractParameter & parameter) override;
 	virtual void deserialize(ofAbstractParameter & parameter) override;
+	/** reads the whole file and validates it like loadFromBuffer(): a malformed file is rejected */
 	virtual bool load(const string & path) override;
 	virtual bool save(const string & path) override;
-};
\ No newline at end of file
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+/** Bump allocator for the nodes of a single ofxBson document.
+
+	Nodes are carved out of large contiguous blocks. A node given back is
+	kept on a free list for its size and handed out again to the next node
+	of that size, so a document edited for a long time (every setValue()
+	replaces a node) stays about as big as its tree. The blocks themselves
+	are released in one go when the last node (or document) referencing the
+	arena goes away.
+
+	Nodes are only allocated by the thread that owns the document, but the
+	ones a snapshot shares may be given back from any thread: the free lists
+	take them without locking, and only the allocating thread takes from them.
+	The document may change hands (an async load parses on a worker before
+	the main thread takes over), as long as two threads never allocate at
+	once: debug builds assert it.
+*/
+class ofxBsonArena {
+public:
+	enum { DefaultBlockSize = 64 * 1024 };
+	// sizes are recycled in steps of Granularity up to MaxRecycledSize: every node type fits.
+	// bigger allocations stay taken until the arena goes away
+	enum { Granularity = 16, MaxRecycledSize = 512 };
+
+	ofxBsonArena(size_t blockSize = DefaultBlockSize) :
+		blockSize(blockSize), pos(0), end(0), allocations(0), reused(0), bytesUsed(0), bytesReserved(0) {
+		for (auto& list : freeLists) {
+			list = 0;
+		}
+#ifndef NDEBUG
+		allocatingNow = false;
+#endif
+	}
+	~ofxBsonArena() {
+		for (auto block : blocks) {
+			free(block);
+		}
+	}
+
+	void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+#ifndef NDEBUG
+		Allocating allocating(allocatingNow);
+#endif
+		allocations++;
+		bytesUsed += size;
+		if (recycles(size, align)) {
+			size = roundUp(size);
+			if (void* p = pop(freeLists[size / Granularity])) {
+				reused++;
+				return p;
+			}
+		}
+		char* p = (char*)(((uintptr_t)pos + (align - 1)) & ~(uintptr_t)(align - 1));
+		if (!pos || p + size > end) {
+			p = grow(size + align);
+			p = (char*)(((uintptr_t)p + (align - 1)) & ~(uintptr_t)(align - 1));
+		}
+		pos = p + size;
+		return p;
+	}
+
+	/** takes back what allocate(size, align) returned, from any thread */
+	void deallocate(void* p, size_t size, size_t align = alignof(std::max_align_t)) {
+		bytesUsed -= size;
+		if (recycles(size, align)) {
+			push(freeLists[roundUp(size) / Granularity], p);
+		}
+	}
+
+	/** number of allocations served since the arena was created */
+	size_t getAllocationCount() const { return allocations; }
+	/** how many of them were served from memory given back before */
+	size_t getReusedCount() const { return reused; }
+	/** bytes handed out to callers and not given back, not counting alignment padding */
+	size_t getBytesUsed() const { return bytesUsed; }
+	/** bytes obtained from the system */
+	size_t getBytesReserved() const { return bytesReserved; }
+	size_t getBlockCount() const { return blocks.size(); }
+
+private:
+	ofxBsonArena(const ofxBsonArena&);
+	ofxBsonArena& operator=(const ofxBsonArena&);
+
+	// a block on a free list holds the next one in its first bytes
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	static bool recycles(size_t size, size_t align) {
+		return size <= MaxRecycledSize && align <= Granularity;
+	}
+	// sizes are rounded up, so every block of a list is aligned and big enough for any request mapped to it
+	static size_t roundUp(size_t size) {
+		size = size < sizeof(FreeBlock) ? sizeof(FreeBlock) : size;
+		return (size + Granularity - 1) & ~(size_t)(Granularity - 1);
+	}
+	static void push(std::atomic<FreeBlock*>& list, void* p) {
+		FreeBlock* block = (FreeBlock*)p;
+		block->next = list.load(std::memory_order_relaxed);
+		while (!list.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+	// only ever called from the allocating thread, so a block can't be popped and pushed
+	// back between the load and the exchange (no ABA)
+	static void* pop(std::atomic<FreeBlock*>& list) {
+		FreeBlock* block = list.load(std::memory_order_acquire);
+		while (block && !list.compare_exchange_weak(block, block->next, std::memory_order_acquire, std::memory_order_acquire)) {}
+		return block;
+	}
+
+#ifndef NDEBUG
+	// marks the arena as being allocated from for the scope of allocate()
+	struct Allocating {
+		Allocating(std::atomic<bool>& flag) : flag(flag) {
+			bool other = flag.exchange(true, std::memory_order_acquire);
+			assert(!other && "ofxBsonArena: allocated from two threads at once");
+			(void)other;
+		}
+		~Allocating() { flag.store(false, std::memory_order_release); }
+		std::atomic<bool>& flag;
+	};
+#endif
+
+	char* grow(size_t atLeast) {
+		size_t sz = atLeast > blockSize ? atLeast : blockSize;
+		char* block = (char*)malloc(sz);
+		if (!block) {
+			throw std::bad_alloc();
+		}
+		blocks.push_back(block);
+		bytesReserved += sz;
+		pos = block;
+		end = block + sz;
+		return block;
+	}
+
+	size_t blockSize;
+	char* pos;
+	char* end;
+	std::vector<char*> blocks;
+	std::atomic<FreeBlock*> freeLists[MaxRecycledSize / Granularity + 1];
+	size_t allocations;
+	size_t reused;
+	std::atomic<size_t> bytesUsed;
+	size_t bytesReserved;
+#ifndef NDEBUG
+	std::atomic<bool> allocatingNow;
+#endif
+};
+
+/** std allocator adaptor over ofxBsonArena, for use with allocate_shared.
+	Every copy keeps the arena alive, so the control blocks of the nodes
+	hold on to their memory until the whole tree is gone.
+*/
+template <typename T>
+class ofxBsonArenaAllocator {
+public:
+	typedef T value_type;
+
+	ofxBsonArenaAllocator(std::shared_ptr<ofxBsonArena> arena) : arena(arena) {}
+	template <typename U>
+	ofxBsonArenaAllocator(const ofxBsonArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t n) {
+		return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T* p, size_t n) {
+		arena->deallocate(p, n * sizeof(T), alignof(T));
+	}
+
+	template <typename U>
+	bool operator==(const ofxBsonArenaAllocator<U>& other) const { return arena == other.arena; }
+	template <typename U>
+	bool operator!=(const ofxBsonArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	std::shared_ptr<ofxBsonArena> arena;
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ofxBsonKeyTable.h"
+
+/** insertion-ordered field map used for the fields of an object node.
+
+	fields live in one contiguous vector, so iteration (and saving) walks
+	memory in order and keeps the keys in the order they were added. small
+	objects are searched linearly; past IndexThreshold fields an open
+	addressed hash index over the vector is kept, so a lookup is a single
+	probe sequence regardless of the object size.
+
+	keys are interned ofxBsonKeys of the owning document: lookups by key
+	compare pointers, lookups by name compare the precomputed hashes first.
+*/
+template <typename V>
+class ofxBsonFieldMap {
+public:
+	typedef std::pair<const ofxBsonKey*, V> value_type;
+	typedef typename std::vector<value_type>::iterator iterator;
+	typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+	enum { IndexThreshold = 8 };
+
+	iterator begin() { return fields.begin(); }
+	iterator end() { return fields.end(); }
+	const_iterator begin() const { return fields.begin(); }
+	const_iterator end() const { return fields.end(); }
+	const_iterator cbegin() const { return fields.begin(); }
+	const_iterator cend() const { return fields.end(); }
+
+	size_t size() const { return fields.size(); }
+	bool empty() const { return fields.empty(); }
+
+	void clear() {
+		fields.clear();
+		index.clear();
+	}
+
+	void reserve(size_t n) {
+		fields.reserve(n);
+	}
+
+	iterator find(const std::string& name) {
+		size_t pos = position(name.data(), name.size(), ofxBsonKey::hashOf(name));
+		return pos == npos ? fields.end() : fields.begin() + pos;
+	}
+	const_iterator find(const std::string& name) const {
+		size_t pos = position(name.data(), name.size(), ofxBsonKey::hashOf(name));
+		return pos == npos ? fields.end() : fields.begin() + pos;
+	}
+	iterator find(const ofxBsonKey* key) {
+		size_t pos = position(key);
+		return pos == npos ? fields.end() : fields.begin() + pos;
+	}
+	const_iterator find(const ofxBsonKey* key) const {
+		size_t pos = position(key);
+		return pos == npos ? fields.end() : fields.begin() + pos;
+	}
+
+	/** the value stored under key, default constructed and appended if missing */
+	V& operator[](const ofxBsonKey* key) {
+		size_t pos = position(key);
+		if (pos != npos) {
+			return fields[pos].second;
+		}
+		fields.push_back(value_type(key, V()));
+		if (!index.empty()) {
+			if ((fields.size() * 2) > index.size()) {
+				rebuildIndex();
+			} else {
+				insertIndex(key->hash, (uint32_t)fields.size() - 1);
+			}
+		} else if (fields.size() > IndexThreshold) {
+			rebuildIndex();
+		}
+		return fields.back().second;
+	}
+
+	/** removes a field, keeping the order of the remaining ones. @return the number of fields removed */
+	size_t erase(const std::string& name) {
+		size_t pos = position(name.data(), name.size(), ofxBsonKey::hashOf(name));
+		if (pos == npos) {
+			return 0;
+		}
+		fields.erase(fields.begin() + pos);
+		if (fields.size() > IndexThreshold) {
+			rebuildIndex();
+		} else {
+			index.clear();
+		}
+		return 1;
+	}
+
+private:
+	static const size_t npos = (size_t)-1;
+
+	struct Slot {
+		uint32_t hash;
+		uint32_t pos; // field position + 1, 0 marks an empty slot
+	};
+
+	size_t position(const char* name, size_t len, uint32_t h) const {
+		if (index.empty()) {
+			for (size_t i = 0; i < fields.size(); i++) {
+				const ofxBsonKey* k = fields[i].first;
+				if (k->hash == h && k->equals(name, len)) {
+					return i;
+				}
+			}
+			return npos;
+		}
+		size_t mask = index.size() - 1;
+		for (size_t i = h & mask;; i = (i + 1) & mask) {
+			const Slot& slot = index[i];
+			if (!slot.pos) {
+				return npos;
+			}
+			if (slot.hash == h && fields[slot.pos - 1].first->equals(name, len)) {
+				return slot.pos - 1;
+			}
+		}
+	}
+
+	size_t position(const ofxBsonKey* key) const {
+		if (index.empty()) {
+			for (size_t i = 0; i < fields.size(); i++) {
+				if (fields[i].first == key) {
+					return i;
+				}
+			}
+			return npos;
+		}
+		size_t mask = index.size() - 1;
+		for (size_t i = key->hash & mask;; i = (i + 1) & mask) {
+			const Slot& slot = index[i];
+			if (!slot.pos) {
+				return npos;
+			}
+			if (fields[slot.pos - 1].first == key) {
+				return slot.pos - 1;
+			}
+		}
+	}
+
+	void insertIndex(uint32_t h, uint32_t pos) {
+		size_t mask = index.size() - 1;
+		size_t i = h & mask;
+		while (index[i].pos) {
+			i = (i + 1) & mask;
+		}
+		index[i].hash = h;
+		index[i].pos = pos + 1;
+	}
+
+	void rebuildIndex() {
+		size_t cap = 16;
+		while (cap < fields.size() * 4) {
+			cap *= 2;
+		}
+		index.assign(cap, Slot());
+		for (size_t i = 0; i < fields.size(); i++) {
+			insertIndex(fields[i].first->hash, (uint32_t)i);
+		}
+	}
+
+	std::vector<value_type> fields;
+	std::vector<Slot> index;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** an interned field name. keys of one document are unique per name, so two
+	keys from the same table are equal exactly when their addresses are.
+*/
+struct ofxBsonKey {
+	std::string name;
+	uint32_t hash;
+
+	ofxBsonKey(const char* s, size_t len, uint32_t hash) : name(s, len), hash(hash) {}
+
+	bool equals(const char* s, size_t len) const {
+		return name.size() == len && memcmp(name.data(), s, len) == 0;
+	}
+
+	static uint32_t hashOf(const char* s, size_t len) {
+		// FNV-1a
+		uint32_t h = 2166136261u;
+		for (size_t i = 0; i < len; i++) {
+			h ^= (unsigned char)s[i];
+			h *= 16777619u;
+		}
+		return h;
+	}
+	static uint32_t hashOf(const std::string& s) { return hashOf(s.data(), s.size()); }
+};
+
+/** per-document table of interned field names.
+
+	documents made of many similar records repeat the same few keys over
+	and over; each name is stored (and hashed) once here and objects only
+	keep a pointer to it. keys never move or go away while the table lives.
+*/
+class ofxBsonKeyTable {
+public:
+	ofxBsonKeyTable() : count(0), shared(false) {}
+
+	const ofxBsonKey* intern(const char* s, size_t len) {
+		if (shared) {
+			std::lock_guard<std::mutex> guard(lock);
+			return insert(s, len);
+		}
+		return insert(s, len);
+	}
+	const ofxBsonKey* intern(const std::string& s) { return intern(s.data(), s.size()); }
+
+	/** from now on intern() may be called from several threads at once, for a table used by
+		documents that share nodes with each other. keys already handed out stay where they are.
+		call it before the other threads start interning: one already inside intern() doesn't lock.
+	*/
+	void share() { shared = true; }
+
+	/** @return the interned key for s, or null if no field was ever called that */
+	const ofxBsonKey* find(const char* s, size_t len) const {
+		return find(s, len, ofxBsonKey::hashOf(s, len));
+	}
+
+	size_t size() const { return count; }
+
+private:
+	ofxBsonKeyTable(const ofxBsonKeyTable&);
+	ofxBsonKeyTable& operator=(const ofxBsonKeyTable&);
+
+	const ofxBsonKey* insert(const char* s, size_t len) {
+		uint32_t h = ofxBsonKey::hashOf(s, len);
+		const ofxBsonKey* found = find(s, len, h);
+		if (found) {
+			return found;
+		}
+		keys.push_back(ofxBsonKey(s, len, h));
+		const ofxBsonKey* key = &keys.back();
+		if ((++count * 2) > index.size()) {
+			rebuildIndex();
+		} else {
+			insertIndex(key);
+		}
+		return key;
+	}
+
+	const ofxBsonKey* find(const char* s, size_t len, uint32_t h) const {
+		if (index.empty()) {
+			return 0;
+		}
+		size_t mask = index.size() - 1;
+		for (size_t i = h & mask; index[i]; i = (i + 1) & mask) {
+			if (index[i]->hash == h && index[i]->equals(s, len)) {
+				return index[i];
+			}
+		}
+		return 0;
+	}
+
+	void insertIndex(const ofxBsonKey* key) {
+		size_t mask = index.size() - 1;
+		size_t i = key->hash & mask;
+		while (index[i]) {
+			i = (i + 1) & mask;
+		}
+		index[i] = key;
+	}
+
+	void rebuildIndex() {
+		size_t cap = 64;
+		while (cap < count * 4) {
+			cap *= 2;
+		}
+		index.assign(cap, (const ofxBsonKey*)0);
+		for (auto& key : keys) {
+			insertIndex(&key);
+		}
+	}
+
+	std::deque<ofxBsonKey> keys;
+	std::vector<const ofxBsonKey*> index;
+	size_t count;
+	std::atomic<bool> shared;
+	std::mutex lock;
+};
@@ -0,0 +1,98 @@
+#include "ofxBsonMappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ofxBsonMappedFile::ofxBsonMappedFile() : data(0), length(0)
+#ifdef _WIN32
+	, file(INVALID_HANDLE_VALUE), mapping(0)
+#endif
+{
+}
+
+ofxBsonMappedFile::~ofxBsonMappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+bool ofxBsonMappedFile::open(const std::string & path) {
+	close();
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER sz;
+	if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		close();
+		return false;
+	}
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		close();
+		return false;
+	}
+	length = (size_t)sz.QuadPart;
+	return true;
+}
+
+void ofxBsonMappedFile::close() {
+	if (data) {
+		UnmapViewOfFile(data);
+		data = 0;
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+		mapping = 0;
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+	length = 0;
+}
+
+#else
+
+bool ofxBsonMappedFile::open(const std::string & path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid after the descriptor is closed
+	::close(fd);
+	if (p == MAP_FAILED) {
+		return false;
+	}
+	data = (const char*)p;
+	length = (size_t)st.st_size;
+	return true;
+}
+
+void ofxBsonMappedFile::close() {
+	if (data) {
+		munmap((void*)data, length);
+		data = 0;
+	}
+	length = 0;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/** read-only memory mapping of a whole file.
+
+	used by ofxBson::loadMapped() to parse documents in place: the kernel
+	pages in only the regions that are actually read, and nothing is copied
+	to the heap. the mapping is released when the object is destroyed.
+*/
+class ofxBsonMappedFile {
+public:
+	ofxBsonMappedFile();
+	~ofxBsonMappedFile();
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return data != 0; }
+	const char* getData() const { return data; }
+	size_t size() const { return length; }
+
+private:
+	ofxBsonMappedFile(const ofxBsonMappedFile&);
+	ofxBsonMappedFile& operator=(const ofxBsonMappedFile&);
+
+	const char* data;
+	size_t length;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+};
@@ -0,0 +1,338 @@
+#include "ofxBsonParameterPlan.h"
+#include <algorithm>
+
+using namespace _bson;
+
+void ofxBsonParameterPlan::compile(ofAbstractParameter & parameter) {
+	clear();
+	add(parameter, 0, NoParent);
+	listed.assign(entries.size(), 0);
+	if (!entries.empty() && entries[0].kind == Group) {
+		// changes anywhere below, subgroups included, are told to the top group
+		root = &parameter;
+		ofAddListener(parameter.castGroup().parameterChangedE(), this, &ofxBsonParameterPlan::onParameterChanged);
+	}
+	resetDelta();
+}
+
+void ofxBsonParameterPlan::clear() {
+	if (root) {
+		ofRemoveListener(root->castGroup().parameterChangedE(), this, &ofxBsonParameterPlan::onParameterChanged);
+		root = 0;
+	}
+	entries.clear();
+	values = 0;
+	lookup.assign(1, unordered_map<string, size_t>());
+	sent.clear();
+	byName.clear();
+	changed.clear();
+	listed.clear();
+}
+
+void ofxBsonParameterPlan::add(ofAbstractParameter & parameter, size_t table, size_t parent) {
+	if (!parameter.isSerializable()) {
+		return;
+	}
+	Entry e;
+	e.parameter = &parameter;
+	char type;
+	if (dynamic_cast<ofParameterGroup *>(&parameter) != NULL) {
+		e.kind = Group;
+		type = Object;
+	} else if (parameter.type() == typeid(ofParameter<int>).name()) {
+		e.kind = Int;
+		type = NumberInt;
+	} else if (parameter.type() == typeid(ofParameter<float>).name()) {
+		e.kind = Float;
+		type = NumberDouble;
+	} else if (parameter.type() == typeid(ofParameter<double>).name()) {
+		e.kind = Double;
+		type = NumberDouble;
+	} else if (parameter.type() == typeid(ofParameter<bool>).name()) {
+		e.kind = Bool;
+		type = _bson::Bool;
+	} else if (parameter.type() == typeid(ofParameter<string>).name()) {
+		e.kind = String;
+		type = _bson::String;
+	} else {
+		e.kind = Other;
+		type = _bson::String;
+	}
+	e.key.push_back(type);
+	e.key += parameter.getEscapedName();
+	e.key.push_back(0);
+	e.next = entries.size() + 1;
+	e.group = 0;
+	e.parent = parent;
+	lookup[table][e.name()] = entries.size();
+	entries.push_back(e);
+	if (e.kind != Group) {
+		byName.insert(make_pair(string(e.name()), entries.size() - 1));
+		values++;
+		return;
+	}
+	size_t at = entries.size() - 1;
+	size_t group = lookup.size();
+	entries[at].group = group;
+	lookup.push_back(unordered_map<string, size_t>());
+	for (auto& p : parameter.castGroup()) {
+		add(*p, group, at);
+	}
+	Entry end;
+	end.kind = End;
+	end.parameter = 0;
+	end.next = entries.size() + 1;
+	end.group = 0;
+	end.parent = at;
+	entries.push_back(end);
+	entries[at].next = entries.size();
+}
+
+void ofxBsonParameterPlan::write(bsonobjbuilder & b) {
+	writeEntries(b.bb());
+}
+
+bsonobj ofxBsonParameterPlan::obj() {
+	return build(false);
+}
+
+bsonobj ofxBsonParameterPlan::delta() {
+	if (!root && !entries.empty()) {
+		// a single parameter, with no group to tell when it changes: compared every time
+		markChanged(0);
+	}
+	return build(true);
+}
+
+void ofxBsonParameterPlan::resetDelta() {
+	sent.assign(entries.size(), string());
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].kind != Group && entries[i].kind != End) {
+			markChanged(i);
+		}
+	}
+}
+
+void ofxBsonParameterPlan::markChanged(size_t i) {
+	if (!listed[i]) {
+		listed[i] = 1;
+		changed.push_back(i);
+	}
+}
+
+void ofxBsonParameterPlan::onParameterChanged(ofAbstractParameter & parameter) {
+	auto found = byName.equal_range(parameter.getEscapedName());
+	for (auto it = found.first; it != found.second; ++it) {
+		markChanged(it->second);
+	}
+}
+
+bsonobj ofxBsonParameterPlan::build(bool changedOnly) {
+	out.reset();
+	out.skip(4);
+	if (changedOnly) {
+		writeChanged(out);
+	} else {
+		writeEntries(out);
+	}
+	out.appendNum((char)EOO);
+	int size = endian_int(out.len());
+	memcpy(out.buf(), &size, 4);
+	return bsonobj(out.buf());
+}
+
+void ofxBsonParameterPlan::writeEntries(BufBuilder & to) {
+	open.clear();
+	for (size_t i = 0; i < entries.size(); i++) {
+		const Entry& e = entries[i];
+		if (e.kind == End) {
+			closeGroup(to, false);
+		} else if (e.kind == Group) {
+			openGroup(e, to);
+		} else {
+			to.appendBuf(e.key.data(), e.key.size());
+			writeValue(e, to);
+		}
+	}
+}
+
+void ofxBsonParameterPlan::writeChanged(BufBuilder & to) {
+	open.clear();
+	openEntries.clear();
+	// in the order of the entries, so every group is opened once
+	sort(changed.begin(), changed.end());
+	for (size_t i : changed) {
+		listed[i] = 0;
+		const Entry& e = entries[i];
+		while (!openEntries.empty() && i >= entries[openEntries.back()].next) {
+			openEntries.pop_back();
+			closeGroup(to, true);
+		}
+		entering.clear();
+		for (size_t g = e.parent; g != NoParent && (openEntries.empty() || g != openEntries.back()); g = entries[g].parent) {
+			entering.push_back(g);
+		}
+		for (auto g = entering.rbegin(); g != entering.rend(); ++g) {
+			openGroup(entries[*g], to);
+			openEntries.push_back(*g);
+		}
+		int key = to.len();
+		to.appendBuf(e.key.data(), e.key.size());
+		int value = to.len();
+		writeValue(e, to);
+		// set back to what was sent last, or changed and changed back: nothing to send
+		string& last = sent[i];
+		size_t len = to.len() - value;
+		if (last.size() == len && memcmp(last.data(), to.buf() + value, len) == 0) {
+			to.setlen(key);
+		} else {
+			last.assign(to.buf() + value, len);
+		}
+	}
+	while (!openEntries.empty()) {
+		openEntries.pop_back();
+		closeGroup(to, true);
+	}
+	changed.clear();
+}
+
+void ofxBsonParameterPlan::openGroup(const Entry & e, BufBuilder & to) {
+	int key = to.len();
+	to.appendBuf(e.key.data(), e.key.size());
+	open.push_back(make_pair(key, to.len()));
+	to.skip(4);
+}
+
+void ofxBsonParameterPlan::closeGroup(BufBuilder & to, bool dropEmpty) {
+	auto group = open.back();
+	open.pop_back();
+	if (dropEmpty && to.len() == group.second + 4) {
+		// nothing in it changed: leave the group out
+		to.setlen(group.first);
+		return;
+	}
+	to.appendNum((char)EOO);
+	int size = endian_int(to.len() - group.second);
+	memcpy(to.buf() + group.second, &size, 4);
+}
+
+void ofxBsonParameterPlan::writeValue(const Entry & e, BufBuilder & to) {
+	switch (e.kind) {
+	case Int:
+		to.appendNum((int)e.parameter->cast<int>().get());
+		break;
+	case Float:
+		to.appendNum((double)e.parameter->cast<float>().get());
+		break;
+	case Double:
+		to.appendNum(e.parameter->cast<double>().get());
+		break;
+	case Bool:
+		to.appendNum((char)(e.parameter->cast<bool>().get() ? 1 : 0));
+		break;
+	case String: {
+		const string& s = e.parameter->cast<string>().get();
+		to.appendNum((int)s.size() + 1);
+		to.appendBuf(s.c_str(), s.size() + 1);
+		break;
+	}
+	default: {
+		string s = e.parameter->toString();
+		to.appendNum((int)s.size() + 1);
+		to.appendBuf(s.c_str(), s.size() + 1);
+		break;
+	}
+	}
+}
+
+void ofxBsonParameterPlan::read(const bsonobj & from) {
+	readGroup(from, 0, entries.size());
+}
+
+void ofxBsonParameterPlan::applyDelta(const bsonobj & patch) {
+	applyGroup(patch, 0);
+}
+
+void ofxBsonParameterPlan::applyGroup(const bsonobj & obj, size_t group) {
+	const unordered_map<string, size_t>& names = lookup[group];
+	bsonobjiterator it(obj);
+	while (it.more()) {
+		bsonelement el = it.next();
+		auto found = names.find(el.fieldName());
+		if (found == names.end()) {
+			continue;
+		}
+		const Entry& e = entries[found->second];
+		if (e.kind == Group) {
+			if (el.type() == Object) {
+				applyGroup(el.Obj(), e.group);
+			}
+		} else {
+			readValue(e, el);
+		}
+	}
+}
+
+void ofxBsonParameterPlan::readGroup(const bsonobj & obj, size_t first, size_t last) {
+	bsonobjiterator it(obj);
+	bsonelement next = it.more() ? it.next() : bsonelement();
+	for (size_t i = first; i < last; i = entries[i].next) {
+		const Entry& e = entries[i];
+		bsonelement el;
+		// fields written by a plan or by serialize() come in the order of the entries,
+		// so only look the name up when they don't
+		if (!next.eoo() && strcmp(next.fieldName(), e.name()) == 0) {
+			el = next;
+			next = it.more() ? it.next() : bsonelement();
+		} else {
+			el = obj.getField(e.name());
+		}
+		if (el.eoo()) {
+			continue;
+		}
+		if (e.kind == Group) {
+			if (el.type() == Object) {
+				readGroup(el.Obj(), i + 1, e.next - 1);
+			}
+		} else {
+			readValue(e, el);
+		}
+	}
+}
+
+void ofxBsonParameterPlan::readValue(const Entry & e, const bsonelement & el) {
+	switch (e.kind) {
+	case Int:
+		if (el.isNumber()) {
+			e.parameter->cast<int>() = el.numberInt();
+		}
+		break;
+	case Float:
+		if (el.isNumber()) {
+			e.parameter->cast<float>() = (float)el.number();
+		}
+		break;
+	case Double:
+		if (el.isNumber()) {
+			e.parameter->cast<double>() = el.number();
+		}
+		break;
+	case Bool:
+		if (el.type() == _bson::Bool || el.isNumber()) {
+			e.parameter->cast<bool>() = el.trueValue();
+		}
+		break;
+	case String:
+		if (el.type() == _bson::String) {
+			e.parameter->cast<string>() = el.str();
+		}
+		break;
+	case Other:
+		if (el.type() == _bson::String) {
+			e.parameter->fromString(el.str());
+		}
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ofxBson.h"
+
+/** precompiled serializer for a parameter group sent over and over.
+
+	compile() walks the group once: the type of every parameter is resolved
+	there, and its BSON type byte and field name are encoded ahead of time.
+	write() then replays the flat list of entries, appending each value right
+	after its key bytes, with no type lookups and no node tree in between;
+	read() assigns values back through the same typed entries.
+
+	the layout is the one ofxBson::serialize() builds, so either end can be a
+	plain ofxBson. ints and parameters of other types are written as
+	deserialize() reads them back: as int32 and as their toString().
+	the parameters must outlive the plan. compile again after parameters
+	were added to or removed from the group.
+
+	for live sync, the plan listens to the change events of the group: delta()
+	only visits the parameters changed since the previous one, and writes those
+	whose value differs from what it sent then. applyDelta() only visits the
+	parameters a patch names, so both scale with the amount of change.
+*/
+class ofxBsonParameterPlan {
+public:
+	ofxBsonParameterPlan() : values(0), root(0) {}
+	explicit ofxBsonParameterPlan(ofAbstractParameter& parameter) : values(0), root(0) { compile(parameter); }
+	~ofxBsonParameterPlan() { clear(); }
+
+	void compile(ofAbstractParameter& parameter);
+	void clear();
+	bool empty() const { return entries.empty(); }
+	/** number of values written, groups not included */
+	size_t size() const { return values; }
+
+	/** appends the parameter to b, as serialize() adds it to the current object */
+	void write(_bson::bsonobjbuilder& b);
+	/** a document holding the parameter, built in a buffer that is reused from call to
+		call. valid until the next call or until the plan goes away.
+	*/
+	_bson::bsonobj obj();
+	/** sets the parameters from an object laid out like obj(). missing fields, and fields
+		of a type that does not fit their parameter, are skipped.
+	*/
+	void read(const _bson::bsonobj& from);
+
+	/** a patch holding only the values that changed since the previous delta(), every
+		value the first time. it is laid out like obj(), minus the unchanged values and
+		the groups left empty; nothing changed gives an empty document. same lifetime as obj().
+	*/
+	_bson::bsonobj delta();
+	/** forgets the values sent, so that the next delta() holds all of them */
+	void resetDelta();
+	/** sets the parameters a patch made by delta() names, and only those */
+	void applyDelta(const _bson::bsonobj& patch);
+
+private:
+	ofxBsonParameterPlan(const ofxBsonParameterPlan&);
+	ofxBsonParameterPlan& operator=(const ofxBsonParameterPlan&);
+
+	enum Kind { Group, End, Int, Float, Double, Bool, String, Other };
+	struct Entry {
+		Kind kind;
+		// type byte, field name and terminator, as they go in front of the value
+		std::string key;
+		ofAbstractParameter* parameter;
+		// index of the entry that follows, past the end marker for groups
+		size_t next;
+		// for groups, the lookup table of their children
+		size_t group;
+		// index of the group entry it is in, NoParent at the top level
+		size_t parent;
+		const char* name() const { return key.c_str() + 1; }
+	};
+	enum { NoParent = ~(size_t)0 };
+
+	/** @param table lookup table of the group it goes in, parent entry of that group */
+	void add(ofAbstractParameter& parameter, size_t table, size_t parent);
+	_bson::bsonobj build(bool changedOnly);
+	void writeEntries(_bson::BufBuilder& to);
+	/** writes the entries listed in changed, in the groups they are in */
+	void writeChanged(_bson::BufBuilder& to);
+	void openGroup(const Entry& e, _bson::BufBuilder& to);
+	/** ends the innermost open group; one left empty is taken out again if dropEmpty */
+	void closeGroup(_bson::BufBuilder& to, bool dropEmpty);
+	void markChanged(size_t i);
+	void onParameterChanged(ofAbstractParameter& parameter);
+	static void writeValue(const Entry& e, _bson::BufBuilder& to);
+	void readGroup(const _bson::bsonobj& obj, size_t first, size_t last);
+	void applyGroup(const _bson::bsonobj& obj, size_t group);
+	static void readValue(const Entry& e, const _bson::bsonelement& el);
+
+	std::vector<Entry> entries;
+	size_t values;
+	// entry by field name, for the top level (0) and for every group
+	std::vector<std::unordered_map<std::string, size_t>> lookup;
+	// encoded value of every entry as the last delta() wrote it, empty before
+	std::vector<std::string> sent;
+	// the group compiled, while the plan listens to it
+	ofAbstractParameter* root;
+	// entries of the value parameters by name, to find those the change events name. the
+	// event may come from another handle to the parameter than the one compiled, so it is
+	// matched by name: parameters of the same name in other groups are compared for nothing
+	std::unordered_multimap<std::string, size_t> byName;
+	// entries changed since the last delta(), each once, and whether an entry is listed there
+	std::vector<size_t> changed;
+	std::vector<char> listed;
+	_bson::BufBuilder out;
+	// offsets of the key and of the size field of the groups open while writing
+	std::vector<std::pair<int, int>> open;
+	// their entries while writing changes, and the groups to open before the next one
+	std::vector<size_t> openEntries;
+	std::vector<size_t> entering;
+};
@@ -0,0 +1,212 @@
+#include "ofxBsonStreamWriter.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+	// unique among the saves of this process and of any other one writing to the same directory
+	std::string tempPathFor(const std::string& path) {
+		static std::atomic<unsigned> saves(0);
+#ifdef _WIN32
+		int pid = _getpid();
+#else
+		int pid = (int)getpid();
+#endif
+		return path + "." + std::to_string(pid) + "." + std::to_string(saves++) + ".tmp";
+	}
+}
+
+ofxBsonStreamWriter::ofxBsonStreamWriter(size_t chunkSize) :
+	chunk(chunkSize < 64 ? 64 : chunkSize), inMemory(false), used(0), flushed(0), fd(-1), ok(false) {
+	buf = &chunk[0];
+	capacity = chunk.size();
+}
+
+ofxBsonStreamWriter::~ofxBsonStreamWriter() {
+	close();
+}
+
+bool ofxBsonStreamWriter::open(const std::string & path) {
+	close();
+	this->path = path;
+	tempPath = tempPathFor(path);
+#ifdef _WIN32
+	fd = _open(tempPath.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+#endif
+	buf = &chunk[0];
+	capacity = chunk.size();
+	inMemory = false;
+	used = 0;
+	flushed = 0;
+	starts.clear();
+	ok = fd >= 0;
+	return ok;
+}
+
+bool ofxBsonStreamWriter::open(char * dst, size_t size) {
+	close();
+	buf = dst;
+	capacity = size;
+	inMemory = true;
+	used = 0;
+	flushed = 0;
+	starts.clear();
+	ok = true;
+	return ok;
+}
+
+bool ofxBsonStreamWriter::close() {
+	if (inMemory) {
+		inMemory = false;
+		if (!starts.empty()) {
+			ok = false;
+		}
+		buf = &chunk[0];
+		capacity = chunk.size();
+		used = 0;
+		return ok;
+	}
+	if (fd < 0) {
+		return false;
+	}
+	if (!starts.empty()) {
+		// an unfinished document is not a valid file
+		ok = false;
+	}
+	flush();
+	// on disk before it replaces anything, or a crash could leave an empty file behind
+#ifdef _WIN32
+	if (ok && _commit(fd) != 0) ok = false;
+	if (_close(fd) != 0) ok = false;
+#else
+	if (ok && fsync(fd) != 0) ok = false;
+	if (::close(fd) != 0) ok = false;
+#endif
+	fd = -1;
+	// readers of the old file (a mapping of it included) keep it until they let go.
+	// windows refuses to replace a file that is still mapped: the save fails instead
+#ifdef _WIN32
+	if (ok && !MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		ok = false;
+	}
+#else
+	if (ok && rename(tempPath.c_str(), path.c_str()) != 0) {
+		ok = false;
+	}
+#endif
+	if (!ok) {
+		remove(tempPath.c_str());
+	}
+	return ok;
+}
+
+void ofxBsonStreamWriter::done() {
+	if (starts.empty()) {
+		ok = false;
+		return;
+	}
+	appendChar(0); // EOO
+	long long start = starts.back();
+	starts.pop_back();
+	long long size = len() - start;
+	if (size > std::numeric_limits<int>::max()) {
+		ok = false;
+		return;
+	}
+	patchInt(start, (int)size);
+}
+
+void ofxBsonStreamWriter::appendBuf(const void * src, size_t n) {
+	const char* p = (const char*)src;
+	while (n > 0) {
+		if (used == capacity && !flush()) {
+			return;
+		}
+		size_t room = capacity - used;
+		size_t c = n < room ? n : room;
+		memcpy(buf + used, p, c);
+		used += c;
+		p += c;
+		n -= c;
+	}
+}
+
+void ofxBsonStreamWriter::patchInt(long long offset, int value) {
+	int v = _bson::endian_int(value);
+	const char* src = (const char*)&v;
+	size_t n = sizeof(v);
+	if (offset < flushed) {
+		if (fd < 0 || !ok) {
+			ok = false;
+			return;
+		}
+		// the length prefix already left the buffer (maybe only partly): back-patch the file
+		size_t onDisk = flushed - offset < (long long)n ? (size_t)(flushed - offset) : n;
+#ifdef _WIN32
+		if (_lseeki64(fd, offset, SEEK_SET) != offset ||
+			_write(fd, src, (unsigned)onDisk) != (int)onDisk ||
+			_lseeki64(fd, flushed, SEEK_SET) != flushed) {
+			ok = false;
+		}
+#else
+		if (pwrite(fd, src, onDisk, (off_t)offset) != (ssize_t)onDisk) {
+			ok = false;
+		}
+#endif
+		src += onDisk;
+		n -= onDisk;
+		offset += onDisk;
+	}
+	if (n > 0) {
+		memcpy(buf + (size_t)(offset - flushed), src, n);
+	}
+}
+
+bool ofxBsonStreamWriter::flush() {
+	if (inMemory) {
+		// the region is all there is
+		ok = false;
+		return false;
+	}
+	if (used == 0) {
+		return true;
+	}
+	if (fd >= 0 && ok) {
+		const char* p = buf;
+		size_t left = used;
+		while (left > 0) {
+#ifdef _WIN32
+			int w = _write(fd, p, (unsigned)left);
+#else
+			ssize_t w = ::write(fd, p, left);
+#endif
+			if (w <= 0) {
+				ok = false;
+				break;
+			}
+			p += w;
+			left -= w;
+		}
+	} else {
+		ok = false;
+	}
+	flushed += used;
+	used = 0;
+	return true;
+}
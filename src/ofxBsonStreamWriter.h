@@ -0,0 +1,141 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "bson/bsonobj.h"
+
+/** writes a BSON document straight to a file while it is being built.
+
+	the interface follows bsonobjbuilder, but completed bytes are flushed to
+	the file descriptor in chunks instead of accumulating in one growing
+	buffer. the length prefix of every (sub)document is reserved when it is
+	started and patched when it is done: in place if it is still in the
+	chunk buffer, with a positioned write if it was already flushed. peak
+	memory is bounded by the chunk size, whatever the size of the document.
+
+	it can also write into a fixed region of memory, e.g. one slice of an
+	output buffer whose layout is already known; running out of room there
+	is an error like a failed write.
+*/
+class ofxBsonStreamWriter {
+public:
+	enum { DefaultChunkSize = 1024 * 1024 };
+
+	ofxBsonStreamWriter(size_t chunkSize = DefaultChunkSize);
+	~ofxBsonStreamWriter();
+
+	/** the bytes go to a temporary file next to path, which replaces path when
+		close() succeeds: the file being written over can still be read (e.g. it
+		is mapped) while the document is built, and a failed save leaves it as it was
+	*/
+	bool open(const std::string& path);
+	/** writes straight into size bytes at dst instead of a file */
+	bool open(char* dst, size_t size);
+	/** flushes what is left, closes the file and moves it in place.
+		@return false if anything failed along the way; the target is untouched then
+	*/
+	bool close();
+	/** false once a write failed or the document outgrew the 32 bit size field */
+	bool good() const { return ok; }
+
+	/** starts the top level document */
+	void start() { startDocument(); }
+	/** ends the innermost open document, appending its EOO and fixing its length */
+	void done();
+
+	void subobjStart(const _bson::StringData& fieldName) {
+		appendHeader(_bson::Object, fieldName);
+		startDocument();
+	}
+	void subarrayStart(const _bson::StringData& fieldName) {
+		appendHeader(_bson::Array, fieldName);
+		startDocument();
+	}
+
+	void appendNull(const _bson::StringData& fieldName) {
+		appendHeader(_bson::jstNULL, fieldName);
+	}
+	void appendBool(const _bson::StringData& fieldName, bool val) {
+		appendHeader(_bson::Bool, fieldName);
+		appendChar(val ? 1 : 0);
+	}
+	void appendNumber(const _bson::StringData& fieldName, double d) {
+		appendHeader(_bson::NumberDouble, fieldName);
+		double v = _bson::endian_d(d);
+		appendBuf(&v, sizeof(v));
+	}
+	void append(const _bson::StringData& fieldName, int n) {
+		appendHeader(_bson::NumberInt, fieldName);
+		appendInt(n);
+	}
+	void append(const _bson::StringData& fieldName, long long n) {
+		appendHeader(_bson::NumberLong, fieldName);
+		long long v = _bson::endian_ll(n);
+		appendBuf(&v, sizeof(v));
+	}
+	void append(const _bson::StringData& fieldName, const std::string& str) {
+		appendHeader(_bson::String, fieldName);
+		appendInt((int)str.size() + 1);
+		appendBuf(str.c_str(), str.size() + 1);
+	}
+	void append(const _bson::StringData& fieldName, const _bson::OID& oid) {
+		appendHeader(_bson::jstOID, fieldName);
+		appendBuf(&oid, 12);
+	}
+	void appendBinData(const _bson::StringData& fieldName, int len, _bson::BinDataType type, const void* data) {
+		appendHeader(_bson::BinData, fieldName);
+		appendInt(len);
+		appendChar((char)type);
+		appendBuf(data, len);
+	}
+	/** copies all the elements of an existing object, e.g. a lazy view that was never modified */
+	void appendElements(const _bson::bsonobj& obj) {
+		if (!obj.isEmpty()) {
+			appendBuf(obj.objdata() + 4, obj.objsize() - 5);
+		}
+	}
+
+	/** bytes produced so far, flushed or not */
+	long long len() const { return flushed + used; }
+
+private:
+	ofxBsonStreamWriter(const ofxBsonStreamWriter&);
+	ofxBsonStreamWriter& operator=(const ofxBsonStreamWriter&);
+
+	void startDocument() {
+		starts.push_back(len());
+		appendInt(0);
+	}
+	void appendHeader(_bson::BSONType type, const _bson::StringData& fieldName) {
+		appendChar((char)type);
+		appendBuf(fieldName.rawData(), fieldName.size());
+		appendChar(0);
+	}
+	void appendChar(char c) {
+		if (used == capacity && !flush()) {
+			return;
+		}
+		buf[used++] = c;
+	}
+	void appendInt(int n) {
+		int v = _bson::endian_int(n);
+		appendBuf(&v, sizeof(v));
+	}
+	void appendBuf(const void* src, size_t n);
+	void patchInt(long long offset, int value);
+	/** @return false if no room could be made */
+	bool flush();
+
+	std::vector<char> chunk;
+	// where bytes go: the chunk in file mode, the caller's region in memory mode
+	char* buf;
+	size_t capacity;
+	bool inMemory;
+	size_t used;
+	long long flushed;
+	std::vector<long long> starts;
+	int fd;
+	std::string path;
+	std::string tempPath;
+	bool ok;
+};
@@ -0,0 +1,133 @@
+#include "ofxBsonThreadPool.h"
+
+namespace {
+	// the pool and queue the current thread works on, if it is a worker
+	thread_local ofxBsonThreadPool* currentPool = 0;
+	thread_local size_t currentQueue = 0;
+}
+
+ofxBsonThreadPool::ofxBsonThreadPool(size_t threads) : queued(0), pending(0), stopping(false) {
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+		if (threads == 0) {
+			threads = 1;
+		}
+	}
+	for (size_t i = 0; i <= threads; i++) {
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	}
+	for (size_t i = 0; i < threads; i++) {
+		workers.push_back(std::thread(&ofxBsonThreadPool::work, this, i));
+	}
+}
+
+ofxBsonThreadPool::~ofxBsonThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ofxBsonThreadPool::submit(Task task) {
+	size_t target = currentPool == this ? currentQueue : workers.size();
+	pending++;
+	{
+		std::lock_guard<std::mutex> guard(queues[target]->lock);
+		queues[target]->tasks.push_back(std::move(task));
+	}
+	queued++;
+	{
+		// taking the lock orders this against a thread about to sleep on an empty pool
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	wake.notify_one();
+	done.notify_all();
+}
+
+void ofxBsonThreadPool::wait() {
+	size_t self = currentPool == this ? currentQueue : workers.size();
+	Task task;
+	while (pending > 0) {
+		if (take(self, task)) {
+			execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleepLock);
+		done.wait(guard, [this]() { return pending == 0 || queued > 0; });
+	}
+	std::exception_ptr e;
+	{
+		std::lock_guard<std::mutex> guard(errorLock);
+		e = error;
+		error = std::exception_ptr();
+	}
+	if (e) {
+		std::rethrow_exception(e);
+	}
+}
+
+bool ofxBsonThreadPool::take(size_t self, Task & task) {
+	if (queued == 0) {
+		return false;
+	}
+	{
+		Queue& own = *queues[self];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			queued--;
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queues.size(); i++) {
+		Queue& other = *queues[(self + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(other.lock);
+		if (!other.tasks.empty()) {
+			task = std::move(other.tasks.front());
+			other.tasks.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ofxBsonThreadPool::execute(Task & task) {
+	try {
+		task();
+	} catch (...) {
+		std::lock_guard<std::mutex> guard(errorLock);
+		if (!error) {
+			error = std::current_exception();
+		}
+	}
+	task = Task();
+	if (--pending == 0) {
+		{
+			std::lock_guard<std::mutex> guard(sleepLock);
+		}
+		done.notify_all();
+	}
+}
+
+void ofxBsonThreadPool::work(size_t self) {
+	currentPool = this;
+	currentQueue = self;
+	Task task;
+	for (;;) {
+		if (take(self, task)) {
+			execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleepLock);
+		wake.wait(guard, [this]() { return stopping || queued > 0; });
+		if (stopping) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** small work-stealing thread pool.
+
+	every worker owns a queue. a task submitted from inside a worker goes to
+	the back of that worker's queue, and workers take their own work from the
+	back, so a task that splits itself keeps working on what it just touched.
+	idle workers steal from the front of the other queues, where the oldest
+	and usually biggest pieces are. wait() puts the calling thread to work
+	too instead of just blocking.
+*/
+class ofxBsonThreadPool {
+public:
+	typedef std::function<void()> Task;
+
+	/** @param threads number of workers, 0 for one per hardware thread */
+	explicit ofxBsonThreadPool(size_t threads = 0);
+	~ofxBsonThreadPool();
+
+	void submit(Task task);
+	/** runs tasks until every submitted one, and everything they submitted, is done.
+		rethrows the first exception a task threw, if any.
+	*/
+	void wait();
+	size_t size() const { return workers.size(); }
+
+private:
+	ofxBsonThreadPool(const ofxBsonThreadPool&);
+	ofxBsonThreadPool& operator=(const ofxBsonThreadPool&);
+
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	/** takes a task from queue self, or steals one from another queue */
+	bool take(size_t self, Task& task);
+	void execute(Task& task);
+	void work(size_t self);
+
+	// one queue per worker, plus a last one shared by the threads outside the pool
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::atomic<size_t> queued;
+	std::atomic<size_t> pending;
+	std::mutex errorLock;
+	std::exception_ptr error;
+	bool stopping;
+};
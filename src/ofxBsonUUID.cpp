@@ -0,0 +1,59 @@
+#include "ofxBsonUUID.h"
+
+namespace {
+	// where the two digits of each byte start in the dashed form
+	const uint8_t dashedAt[ofxBsonUUID::Size] = { 0, 2, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 28, 30, 32, 34 };
+	const char digits[] = "0123456789abcdef";
+
+	// value of a hex digit; anything else sets bad
+	inline unsigned digit(char c, unsigned& bad) {
+		unsigned u = (unsigned char)c;
+		unsigned decimal = (u - '0') < 10;
+		unsigned letter = ((u | 0x20) - 'a') < 6;
+		bad |= (decimal | letter) ^ 1;
+		// letters have bit 6 set: their low nibble is 1 to 6, for 10 to 15
+		return (u & 0xF) + 9 * (u >> 6 & 1);
+	}
+}
+
+bool ofxBsonUUID::parse(const char * s, size_t len, ofxBsonUUID & out) {
+	if (len == TextSize + 2 && s[0] == '{' && s[TextSize + 1] == '}') {
+		s++;
+		len -= 2;
+	}
+	ofxBsonUUID read;
+	unsigned bad = 0;
+	if (len == TextSize) {
+		bad |= (s[8] ^ '-') | (s[13] ^ '-') | (s[18] ^ '-') | (s[23] ^ '-');
+		for (int i = 0; i < Size; i++) {
+			const char* at = s + dashedAt[i];
+			read.bytes[i] = (uint8_t)(digit(at[0], bad) << 4 | digit(at[1], bad));
+		}
+	} else if (len == 2 * Size) {
+		for (int i = 0; i < Size; i++) {
+			read.bytes[i] = (uint8_t)(digit(s[2 * i], bad) << 4 | digit(s[2 * i + 1], bad));
+		}
+	} else {
+		return false;
+	}
+	if (bad) {
+		return false;
+	}
+	out = read;
+	return true;
+}
+
+void ofxBsonUUID::format(char * out) const {
+	out[8] = out[13] = out[18] = out[23] = '-';
+	for (int i = 0; i < Size; i++) {
+		char* at = out + dashedAt[i];
+		at[0] = digits[bytes[i] >> 4];
+		at[1] = digits[bytes[i] & 0xF];
+	}
+}
+
+std::string ofxBsonUUID::str() const {
+	char text[TextSize];
+	format(text);
+	return std::string(text, TextSize);
+}
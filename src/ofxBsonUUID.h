@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/** a GUID as the 16 bytes it is stored as (BinData subtype newUUID).
+
+	objects with a guid are found by these bytes; the text form is only
+	produced when asked for. parse() and format() go through the bytes
+	without branching on the characters, so they cost the same for any
+	GUID and don't stall on the random ones.
+*/
+struct ofxBsonUUID {
+	enum { Size = 16, TextSize = 36 };
+	uint8_t bytes[Size];
+
+	/** the nil uuid, all zero */
+	ofxBsonUUID() { memset(bytes, 0, Size); }
+	explicit ofxBsonUUID(const void* data) { memcpy(bytes, data, Size); }
+
+	/** reads "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx" in either case, with or without braces,
+		or the 32 digits alone. @return false, leaving out alone, if s is none of these
+	*/
+	static bool parse(const char* s, size_t len, ofxBsonUUID& out);
+	static bool parse(const std::string& s, ofxBsonUUID& out) { return parse(s.data(), s.size(), out); }
+
+	/** writes the TextSize characters of the dashed lowercase form, no terminator */
+	void format(char* out) const;
+	std::string str() const;
+
+	bool isNil() const {
+		static const uint8_t nil[Size] = { 0 };
+		return memcmp(bytes, nil, Size) == 0;
+	}
+	bool operator==(const ofxBsonUUID& other) const { return memcmp(bytes, other.bytes, Size) == 0; }
+	bool operator!=(const ofxBsonUUID& other) const { return !(*this == other); }
+
+	/** mixes both halves: good for random uuids and for sequential or padded ones alike */
+	uint64_t hash() const {
+		uint64_t a, b;
+		memcpy(&a, bytes, 8);
+		memcpy(&b, bytes + 8, 8);
+		uint64_t h = (a ^ (b * 0x9E3779B97F4A7C15ull)) * 0xFF51AFD7ED558CCDull;
+		return h ^ (h >> 32);
+	}
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "ofxBsonUUID.h"
+
+/** hash map from uuids to values, used for the objects with a guid of a document.
+
+	open addressed with linear probing over one vector of slots, kept at
+	most half full: a lookup hashes the 16 bytes once and compares them
+	along a short run of neighbouring slots, with no node per entry and no
+	text involved. erase() shifts the run back instead of leaving
+	tombstones, so lookups stay short however the map is used.
+*/
+template <typename V>
+class ofxBsonUUIDMap {
+public:
+	ofxBsonUUIDMap() : count(0) {}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	void clear() {
+		slots.clear();
+		count = 0;
+	}
+
+	/** @return the value stored for key, or null */
+	V* find(const ofxBsonUUID& key) {
+		size_t i = locate(key);
+		return i != npos && slots[i].used ? &slots[i].value : 0;
+	}
+	const V* find(const ofxBsonUUID& key) const {
+		return const_cast<ofxBsonUUIDMap*>(this)->find(key);
+	}
+	bool contains(const ofxBsonUUID& key) const { return find(key) != 0; }
+
+	/** the value stored under key, default constructed and added if missing */
+	V& operator[](const ofxBsonUUID& key) {
+		if ((count + 1) * 2 > slots.size()) {
+			grow();
+		}
+		size_t i = locate(key);
+		Slot& slot = slots[i];
+		if (!slot.used) {
+			slot.used = true;
+			slot.key = key;
+			slot.value = V();
+			count++;
+		}
+		return slot.value;
+	}
+
+	/** @return whether key was there */
+	bool erase(const ofxBsonUUID& key) {
+		size_t i = locate(key);
+		if (i == npos || !slots[i].used) {
+			return false;
+		}
+		size_t mask = slots.size() - 1;
+		// move back the entries of the run that would no longer be found past the hole
+		for (size_t j = (i + 1) & mask; slots[j].used; j = (j + 1) & mask) {
+			size_t home = slots[j].key.hash() & mask;
+			if (((j - home) & mask) >= ((j - i) & mask)) {
+				slots[i] = std::move(slots[j]);
+				i = j;
+			}
+		}
+		slots[i].used = false;
+		slots[i].value = V();
+		count--;
+		return true;
+	}
+
+	/** calls fn(key, value) for every entry, in no particular order */
+	template <typename Fn>
+	void forEach(Fn fn) {
+		for (auto& slot : slots) {
+			if (slot.used) {
+				fn(slot.key, slot.value);
+			}
+		}
+	}
+
+private:
+	enum { npos = (size_t)-1, MinSlots = 16 };
+	struct Slot {
+		ofxBsonUUID key;
+		V value;
+		bool used;
+		Slot() : used(false) {}
+	};
+
+	// the slot holding key, or the free slot where it would go
+	size_t locate(const ofxBsonUUID& key) const {
+		if (slots.empty()) {
+			return npos;
+		}
+		size_t mask = slots.size() - 1;
+		size_t i = key.hash() & mask;
+		while (slots[i].used && slots[i].key != key) {
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+
+	void grow() {
+		std::vector<Slot> old;
+		old.swap(slots);
+		slots.resize(old.empty() ? (size_t)MinSlots : old.size() * 2);
+		size_t mask = slots.size() - 1;
+		for (auto& slot : old) {
+			if (slot.used) {
+				size_t i = slot.key.hash() & mask;
+				while (slots[i].used) {
+					i = (i + 1) & mask;
+				}
+				slots[i] = std::move(slot);
+			}
+		}
+	}
+
+	std::vector<Slot> slots;
+	size_t count;
+};
@@ -0,0 +1,37 @@
+// an arena-backed document edited for a long time must not keep growing: a value set to
+// another type replaces its node, and the memory of the replaced one goes to the next node
+// of its size.
+
+#include <type_traits>
+
+#include "ofxBson.h"
+#include "check.h"
+
+// a bool must not silently turn into a document
+static_assert(!std::is_convertible<bool, ofxBson>::value, "ofxBson(bool) must be explicit");
+
+int main() {
+	ofxBson b(true);
+	b.setValue("name", string("first"));
+	b.setValue("count", (int32_t)0);
+	CHECK(b.getArena() != nullptr);
+
+	for (int i = 0; i < 10000; i++) {
+		// values of the same type are set in place, these change type every time
+		if (i % 2) {
+			b.setValue("name", string("odd"));
+			b.setValue("count", (int32_t)i);
+		} else {
+			b.setValue("name", false);
+			b.setValue("count", i * 0.5);
+		}
+	}
+
+	auto arena = b.getArena();
+	CHECK(arena->getReusedCount() > 0);
+	// a handful of nodes alive: one block is plenty
+	CHECK(arena->getBlockCount() == 1);
+	CHECK(b.getValue("name") == "odd");
+	CHECK(b.getIntValue("count") == 9999);
+	return passed();
+}
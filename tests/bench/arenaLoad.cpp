@@ -0,0 +1,88 @@
+// how long loading a document of many small objects, and tearing it down, takes with and
+// without the arena, and how many allocations each makes from the heap. run by hand, from a
+// release build:
+//   cmake -S tests -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build && build/arenaLoad
+
+#include "ofxBson.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	std::atomic<size_t> heapAllocations(0);
+}
+
+// every allocation of the program goes through here, so both modes are counted the same way
+void* operator new(size_t size) {
+	heapAllocations++;
+	if (void* p = malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+	free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+namespace {
+	// about 200000 objects of a few fields each, some nested
+	void records(ofxBson& b) {
+		b.addArray("records");
+		b.setTo("records");
+		for (int i = 0; i < 200000; i++) {
+			b.pushObject();
+			b.setTo(i);
+			b.setValue("id", (int32_t)i);
+			b.setValue("weight", i * 0.5);
+			b.setValue("label", string("record"));
+			b.addChild("position");
+			b.setTo("position");
+			b.setValue("x", 1.0);
+			b.setValue("y", 2.0);
+			b.setToParent();
+			b.setToParent();
+		}
+		b.setToParent();
+	}
+
+	double since(chrono::steady_clock::time_point start) {
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+
+	void measure(const char* name, bool useArena, const vector<char>& bytes) {
+		const int runs = 5;
+		double loading = 0, freeing = 0;
+		size_t heap = 0, arena = 0;
+		for (int i = 0; i < runs; i++) {
+			size_t before = heapAllocations;
+			auto start = chrono::steady_clock::now();
+			unique_ptr<ofxBson> b(new ofxBson(useArena));
+			b->loadFromBuffer(bytes.data(), bytes.size());
+			loading += since(start);
+			heap = heapAllocations - before;
+			arena = b->isUsingArena() ? b->getArena()->getAllocationCount() : 0;
+			start = chrono::steady_clock::now();
+			b.reset();
+			freeing += since(start);
+		}
+		printf("%-10s load %7.1f ms  free %7.1f ms  heap allocations %9zu  arena allocations %9zu\n",
+			name, loading / runs, freeing / runs, heap, arena);
+	}
+}
+
+int main() {
+	ofxBson b;
+	records(b);
+	vector<char> bytes;
+	b.saveTo(bytes);
+	printf("%.1f MB\n", bytes.size() / 1e6);
+	measure("heap", false, bytes);
+	measure("arena", true, bytes);
+	return 0;
+}
@@ -0,0 +1,112 @@
+// how long getField() takes to find each field of an object, for names of a few lengths, next to
+// the byte by byte scan it had before the names were scanned with SSE2/AVX2. run by hand, from a
+// release build:
+//   cmake -S tests -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build && build/fieldLookup
+
+#include "ofxBson.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace _bson {
+	namespace iter {
+		// defined in bson.cpp, not declared in any header
+		const char * skipValue(const char *elem, const char *valueStart);
+	}
+}
+
+using namespace _bson;
+
+namespace {
+	// getField() as it was: a name is compared wherever a NUL falls at its length, and skipped a byte at a time
+	bsonelement bytewiseGetField(const bsonobj& obj, const char* name, size_t nameSize) {
+		const char *p = obj.objdata();
+		const char *end = p + obj.objsize() - 1;
+		p += 4;
+		while (1) {
+			const char *elem = p;
+			const char *nul = ++p + nameSize;
+			if (nul >= end) {
+				break;
+			}
+			if (*nul == 0 && memcmp(name, p, nameSize) == 0) {
+				return bsonelement((int)nameSize + 1, elem);
+			}
+			while (1) {
+				if (*p++ == 0) {
+					break;
+				}
+				if (*p++ == 0) {
+					break;
+				}
+			}
+			p = iter::skipValue(elem, p);
+			if (*p == 0) {
+				break;
+			}
+		}
+		return bsonelement();
+	}
+
+	// distinct names of minLength to maxLength characters
+	vector<string> namesOf(size_t count, size_t minLength, size_t maxLength) {
+		mt19937 random(1);
+		uniform_int_distribution<size_t> length(minLength, maxLength);
+		vector<string> names;
+		for (size_t i = 0; i < count; i++) {
+			string name = ofToString(i) + "_";
+			name.resize(max(name.size(), length(random)), 'k');
+			names.push_back(name);
+		}
+		return names;
+	}
+
+	template <typename Lookup>
+	double nanosecondsPerLookup(const vector<string>& names, Lookup lookup) {
+		const int runs = 2000000 / (int)names.size();
+		size_t found = 0;
+		auto start = chrono::steady_clock::now();
+		for (int run = 0; run < runs; run++) {
+			for (auto& name : names) {
+				found += lookup(name).eoo() ? 0 : 1;
+			}
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (found != runs * names.size()) {
+			printf("(missed %zu!) ", runs * names.size() - found);
+		}
+		return seconds * 1e9 / (runs * names.size());
+	}
+
+	void measure(size_t count, size_t minLength, size_t maxLength) {
+		vector<string> names = namesOf(count, minLength, maxLength);
+		bsonobjbuilder builder;
+		for (size_t i = 0; i < names.size(); i++) {
+			if (i % 2) {
+				builder.append(names[i], (int)i);
+			} else {
+				builder.append(names[i], 0.5 * i);
+			}
+		}
+		bsonobj obj = builder.obj();
+		double bytewise = nanosecondsPerLookup(names, [&](const string& name) {
+			return bytewiseGetField(obj, name.c_str(), name.size());
+		});
+		double scanned = nanosecondsPerLookup(names, [&](const string& name) {
+			return obj.getField(name);
+		});
+		printf("%3zu fields, names of %3zu-%3zu bytes: bytewise %7.1f ns  scanned %7.1f ns\n",
+			count, minLength, maxLength, bytewise, scanned);
+	}
+}
+
+int main() {
+	for (size_t count : { 16, 256 }) {
+		measure(count, 3, 8);
+		measure(count, 12, 24);
+		measure(count, 40, 80);
+		measure(count, 1, 100);
+	}
+	return 0;
+}
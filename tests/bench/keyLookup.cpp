@@ -0,0 +1,71 @@
+// how long finding a field of an object node takes with ofxBsonFieldMap, by name and by interned
+// key, next to the std::map of names the nodes used before, for objects of a few sizes. run by
+// hand, from a release build:
+//   cmake -S tests -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build && build/keyLookup
+
+#include "ofxBsonFieldMap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+
+using namespace std;
+
+namespace {
+	// names like the ones of records: short, sharing a prefix
+	vector<string> namesOf(size_t count) {
+		vector<string> names;
+		for (size_t i = 0; i < count; i++) {
+			names.push_back("field" + to_string(i));
+		}
+		return names;
+	}
+
+	template <typename Lookup>
+	double nanosecondsPerLookup(size_t count, Lookup lookup) {
+		const size_t runs = 4000000 / count;
+		size_t found = 0;
+		auto start = chrono::steady_clock::now();
+		for (size_t run = 0; run < runs; run++) {
+			for (size_t i = 0; i < count; i++) {
+				found += lookup(i);
+			}
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (found != runs * count) {
+			printf("(missed %zu!) ", runs * count - found);
+		}
+		return seconds * 1e9 / (runs * count);
+	}
+
+	void measure(size_t count) {
+		vector<string> names = namesOf(count);
+		ofxBsonKeyTable keys;
+		vector<const ofxBsonKey*> interned;
+		ofxBsonFieldMap<shared_ptr<int>> fields;
+		map<string, shared_ptr<int>> sorted;
+		for (size_t i = 0; i < count; i++) {
+			interned.push_back(keys.intern(names[i]));
+			fields[interned[i]] = make_shared<int>((int)i);
+			sorted[names[i]] = make_shared<int>((int)i);
+		}
+		double byMap = nanosecondsPerLookup(count, [&](size_t i) {
+			return sorted.find(names[i]) != sorted.end() ? 1 : 0;
+		});
+		double byName = nanosecondsPerLookup(count, [&](size_t i) {
+			return fields.find(names[i]) != fields.end() ? 1 : 0;
+		});
+		double byKey = nanosecondsPerLookup(count, [&](size_t i) {
+			return fields.find(interned[i]) != fields.end() ? 1 : 0;
+		});
+		printf("%4zu fields: std::map %6.1f ns  by name %6.1f ns  by key %6.1f ns\n", count, byMap, byName, byKey);
+	}
+}
+
+int main() {
+	for (size_t count : { 4, 8, 16, 64, 256, 4096 }) {
+		measure(count);
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+// how much memory loading a big file takes, and how long until its first field can be read,
+// with load() and loadMapped(), lazily or not. every load runs in a process of its own, so that
+// its peak resident size isn't hidden by the one before. run by hand, from a release build:
+//   cmake -S tests -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build && build/mappedLoad
+
+#include "ofxBson.h"
+
+#include <chrono>
+#include <cstdio>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+	const string path = "mappedLoad.bson";
+
+	// a small header, then about 64 MB of records
+	void write() {
+		ofxBson b;
+		b.setValue("name", string("mapped"));
+		b.addArray("records");
+		b.setTo("records");
+		string text(600, 'x');
+		for (int i = 0; i < 100000; i++) {
+			b.pushObject();
+			b.setTo(i);
+			b.setValue("id", (int32_t)i);
+			b.setValue("text", text);
+			b.setToParent();
+		}
+		b.setToParent();
+		b.save(path);
+	}
+
+	long peakKilobytes() {
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+	}
+
+	void measure(const char* name, bool mapped, bool lazy) {
+		fflush(stdout);
+		pid_t child = fork();
+		if (child != 0) {
+			int status;
+			waitpid(child, &status, 0);
+			return;
+		}
+		long before = peakKilobytes();
+		auto start = chrono::steady_clock::now();
+		ofxBson b;
+		b.setLazyLoad(lazy);
+		bool loaded = mapped ? b.loadMapped(path) : b.load(path);
+		string first = b.getValue("name");
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		printf("%-18s first field %8.2f ms  peak resident +%7.1f MB%s\n", name, ms,
+			(peakKilobytes() - before) / 1024.0, loaded && first == "mapped" ? "" : "  (failed!)");
+		fflush(stdout);
+		_exit(0);
+	}
+}
+
+int main() {
+	write();
+	measure("load", false, false);
+	measure("load, lazy", false, true);
+	measure("loadMapped", true, false);
+	measure("loadMapped, lazy", true, true);
+	remove(path.c_str());
+	return 0;
+}
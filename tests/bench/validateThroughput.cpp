@@ -0,0 +1,66 @@
+// how fast validateBSON() goes through documents of many small fields, and of a few big
+// strings and binary blocks. run by hand, from a release build:
+//   cmake -S tests -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build && build/validateThroughput
+
+#include "ofxBson.h"
+#include "bson/bson_validate.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace {
+	// about 16 MB of records of a few fields each, some nested
+	void smallFields(ofxBson& b) {
+		b.addArray("records");
+		b.setTo("records");
+		for (int i = 0; i < 200000; i++) {
+			b.pushObject();
+			b.setTo(i);
+			b.setValue("id", (int32_t)i);
+			b.setValue("stamp", (int64_t)i * 1000);
+			b.setValue("weight", i * 0.5);
+			b.setValue("active", i % 2 == 0);
+			b.setValue("label", string("record"));
+			b.addChild("position");
+			b.setTo("position");
+			b.setValue("x", 1.0);
+			b.setValue("y", 2.0);
+			b.setToParent();
+			b.setToParent();
+		}
+		b.setToParent();
+	}
+
+	// about 16 MB in 64 KB strings and buffers
+	void bigValues(ofxBson& b) {
+		string text(64 * 1024, 'x');
+		ofBuffer data(text.data(), text.size());
+		for (int i = 0; i < 128; i++) {
+			b.setValue("text" + ofToString(i), text);
+			b.setBuffer("data" + ofToString(i), data);
+		}
+	}
+
+	void measure(const char* name, ofxBson& b) {
+		vector<char> bytes;
+		b.saveTo(bytes);
+		const int runs = 20;
+		bool ok = true;
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < runs; i++) {
+			ok = _bson::validateBSON(bytes.data(), bytes.size()).isOK() && ok;
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		printf("%-12s %6.1f MB  %6.2f GB/s%s\n", name, bytes.size() / 1e6, bytes.size() * (double)runs / seconds / 1e9, ok ? "" : "  (rejected!)");
+	}
+}
+
+int main() {
+	ofxBson small;
+	smallFields(small);
+	measure("small fields", small);
+	ofxBson big;
+	bigValues(big);
+	measure("big values", big);
+	return 0;
+}
@@ -0,0 +1,56 @@
+// a constructor that throws leaves its object unconstructed, while the objects referring to it
+// are still constructed (getting null for it), and constructAll() throws once all are done.
+
+#include "ofxBson.h"
+#include "check.h"
+
+#include <stdexcept>
+
+namespace {
+	struct Object {
+		shared_ptr<Object> ref;
+	};
+	const string failing = "00000000-0000-4000-8000-000000000001";
+	const string referring = "00000000-0000-4000-8000-000000000002";
+}
+
+int main() {
+	ofxBson b;
+	bool existing;
+	b.addArray("objects");
+	b.setTo("objects");
+	b.pushGUIDObject(failing, "Failing", existing);
+	b.pushGUIDObject(referring, "Object", existing);
+	b.setTo(1);
+	b.setGUIDObject("ref", failing, "Failing", existing);
+	CHECK(existing);
+	b.setToParent();
+	b.setToParent();
+	// many independent ones around them, constructed on every worker
+	b.addArray("others");
+	b.setTo("others");
+	for (int i = 0; i < 100; i++) {
+		char guid[37];
+		snprintf(guid, sizeof(guid), "00000000-0000-4000-8000-%012d", 100 + i);
+		b.pushGUIDObject(guid, "Object", existing);
+	}
+	b.setToParent();
+
+	b.setConstructor("Failing", [](ofxBson&) -> shared_ptr<void> { throw runtime_error("failing"); });
+	b.setConstructor("Object", [](ofxBson& view) {
+		auto o = make_shared<Object>();
+		o->ref = view.getConstructedObjectByGUID<Object>(failing);
+		return o;
+	});
+	bool thrown = false;
+	try {
+		b.constructAll();
+	} catch (const runtime_error&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+	auto o = b.getConstructedObjectByGUID<Object>(referring);
+	CHECK(o && !o->ref);
+	CHECK(b.getConstructedObjectByGUID<Object>("00000000-0000-4000-8000-000000000199"));
+	return passed();
+}
@@ -0,0 +1,19 @@
+// a default constructed cursor is on nothing: it enters nothing and reads nothing, without
+// touching a path it doesn't have.
+
+#include "ofxBson.h"
+#include "check.h"
+
+int main() {
+	ofxBson::Cursor c;
+	CHECK(!c.setTo("field"));
+	CHECK(!c.setTo(0));
+	c.setToParent();
+	CHECK(!c.isArray());
+	CHECK(c.getSize() == 0);
+	CHECK(!c.exists("field"));
+	CHECK(!c.exists(0));
+	CHECK(c.getValue("field") == "");
+	CHECK(c.getGUID(0) == "");
+	return passed();
+}
@@ -0,0 +1,64 @@
+// a cursor enters a reference as the object it stands for, whether the document was loaded
+// lazily or not, and looks it up without storing anything in the ofxBson.
+
+#include "ofxBson.h"
+#include "check.h"
+
+namespace {
+	const string guid = "00000000-0000-4000-8000-000000000001";
+	const string path = "cursorReferences.bson";
+
+	struct Inspected : ofxBson {
+		static size_t storedCount(const ofxBson& b) { return (b.*&Inspected::storedObjects)->size(); }
+	};
+
+	// through a field, then through an array element
+	bool followsReferences(const ofxBson& b) {
+		auto c = b.cursor();
+		if (!c.setTo("refs") || !c.setTo("r") || c.getValue("name") != "target") {
+			return false;
+		}
+		c.setToParent();
+		return c.setTo("list") && c.setTo(0) && c.getValue("name") == "target";
+	}
+}
+
+int main() {
+	{
+		ofxBson b;
+		bool existing;
+		b.addArray("objects");
+		b.setTo("objects");
+		b.pushGUIDObject(guid, "Object", existing);
+		b.setTo(0);
+		b.setValue("name", string("target"));
+		b.setToParent();
+		b.setToParent();
+		b.addChild("refs");
+		b.setTo("refs");
+		b.setGUIDObject("r", guid, "Object", existing);
+		CHECK(existing);
+		b.addArray("list");
+		b.setTo("list");
+		b.pushGUIDObject(guid, "Object", existing);
+		CHECK(existing);
+		b.setToParent();
+		b.setToParent();
+		CHECK(followsReferences(b));
+		CHECK(b.save(path));
+	}
+	for (int lazy = 0; lazy < 2; lazy++) {
+		ofxBson b;
+		b.setLazyLoad(lazy == 1);
+		CHECK(b.load(path));
+		CHECK(followsReferences(b));
+		CHECK(Inspected::storedCount(b) == 0);
+		// and once the ofxBson stored it, from a view sharing the tree
+		CHECK(b.setTo("refs"));
+		CHECK(b.setTo("r"));
+		CHECK(b.getValue("name") == "target");
+		CHECK(Inspected::storedCount(b) == 1);
+		CHECK(followsReferences(*b.snapshot()));
+	}
+	return passed();
+}
@@ -0,0 +1,93 @@
+// every kind of value, as a field and as an array element: the size computed up front and the
+// bytes written by the builder (incremental save), the stream (plain save) and the pool
+// (parallel save) must all agree.
+
+#include "ofxBson.h"
+#include "check.h"
+
+namespace {
+	const string guid = "00000000-0000-4000-8000-000000000002";
+
+	void fillObject(ofxBson& b) {
+		bool existing;
+		b.setNull("null");
+		b.setValue("bool", true);
+		b.setValue("number", 1.5);
+		b.setValue("int32", (int32_t)-7);
+		b.setValue("int64", (int64_t)1 << 40);
+		b.setValue("text", string("some text"));
+		b.setBuffer("buffer", ofBuffer("bytes", 5));
+		b.addChild("object");
+		b.setTo("object");
+		b.setValue("inner", (int32_t)1);
+		b.setToParent();
+		b.addDoubleArray("packed");
+		b.setTo("packed");
+		double values[] = { 1, 2, 3 };
+		b.pushValues(values, 3);
+		b.setToParent();
+		b.addInt32Array("binary", true);
+		b.setTo("binary");
+		int32_t ints[] = { 4, 5 };
+		b.pushValues(ints, 2);
+		b.setToParent();
+		b.setGUIDObject("owner", guid, "Thing", existing);
+		b.setGUIDObject("reference", guid, "Thing", existing);
+	}
+
+	void fillArray(ofxBson& b) {
+		bool existing;
+		b.pushNull();
+		b.pushValue(false);
+		b.pushValue(2.5);
+		b.pushValue((int32_t)3);
+		b.pushValue((int64_t)4);
+		b.pushValue(string("five"));
+		b.pushBuffer(ofBuffer("six", 3));
+		b.setTo(b.pushObject());
+		b.setValue("seven", (int32_t)7);
+		b.setToParent();
+		b.setTo(b.pushArray());
+		b.pushValue((int32_t)8);
+		b.setToParent();
+		b.pushGUIDObject(guid, "Thing", existing);
+	}
+
+	bool build(ofxBson& b, ofBuffer& out) {
+		fillObject(b);
+		b.addArray("list");
+		b.setTo("list");
+		fillArray(b);
+		b.setToParent();
+		return b.saveToBuffer(out) && (long long)out.size() == b.getSerializedSize();
+	}
+
+	bool same(const ofBuffer& a, const ofBuffer& b) {
+		return a.size() == b.size() && memcmp(a.getData(), b.getData(), a.size()) == 0;
+	}
+}
+
+int main() {
+	ofxBson streamed;
+	ofBuffer s;
+	CHECK(build(streamed, s));
+
+	ofxBson built;
+	built.setIncrementalSave(true);
+	ofBuffer i;
+	CHECK(build(built, i));
+	CHECK(same(s, i));
+
+	ofxBson parallel;
+	parallel.setParallelSave(true, 2);
+	ofBuffer p;
+	CHECK(build(parallel, p));
+	CHECK(same(s, p));
+
+	ofxBson loaded;
+	CHECK(loaded.loadFromBuffer(s.getData(), s.size()));
+	CHECK(loaded.getInt64Value("int64") == (int64_t)1 << 40);
+	CHECK(loaded.setTo("list") && loaded.getSize() == 10);
+	CHECK(loaded.getValue(5) == "five");
+	return passed();
+}
@@ -0,0 +1,98 @@
+// scanNul() finds the end of a name wherever it falls across the 16 and 32 byte blocks it reads,
+// and never reads at or past its end. getFields() and FieldSet agree with getField(), and all of
+// them stop at a field name that runs into the end of its object.
+
+#include "ofxBson.h"
+#include "bson/fieldset.h"
+#include "bson/nulscan.h"
+#include "check.h"
+
+#include <memory>
+
+using namespace _bson;
+
+namespace {
+	string nameOf(int i) {
+		return string(1 + i * 2, 'a' + i);
+	}
+
+	// names of 1 to 39 characters, with values of two types in between
+	void fill(bsonobjbuilder& b) {
+		for (int i = 0; i < 20; i++) {
+			string name = nameOf(i);
+			if (i % 2) {
+				b.append(name, i);
+			} else {
+				b.append(name, name.c_str());
+			}
+		}
+	}
+}
+
+int main() {
+	// the NUL at every position of buffers up to 3 blocks of 32, at every alignment, or none
+	for (size_t len = 0; len <= 96; len++) {
+		for (size_t offset = 0; offset < 4; offset++) {
+			for (size_t nul = 0; nul <= len; nul++) {
+				// exactly the bytes scanned, so that reading past them is caught by sanitizers
+				unique_ptr<char[]> buf(new char[offset + len + 1]);
+				char* p = buf.get() + offset;
+				memset(p, 'x', len);
+				if (nul < len) {
+					p[nul] = 0;
+				}
+				CHECK(iter::scanNul(p, p + len) == p + nul);
+			}
+		}
+	}
+
+	bsonobjbuilder builder;
+	fill(builder);
+	bsonobj obj = builder.obj();
+	vector<string> names;
+	for (int i = 0; i < 20; i++) {
+		names.push_back(nameOf(i));
+	}
+	names.push_back("missing");
+	names.push_back(nameOf(3));
+	vector<const char*> list;
+	for (auto& name : names) {
+		list.push_back(name.c_str());
+	}
+	// a few names are compared one by one, more go through a FieldSet: both give what getField() does
+	for (unsigned n : { 3u, 8u, 9u, (unsigned)list.size() }) {
+		for (int repeat = 0; repeat < 2; repeat++) {
+			vector<bsonelement> fields(n);
+			obj.getFields(n, list.data() + list.size() - n, fields.data());
+			for (unsigned i = 0; i < n; i++) {
+				bsonelement expected = obj.getField(list[list.size() - n + i]);
+				CHECK(fields[i].eoo() == expected.eoo());
+				CHECK(expected.eoo() || fields[i].rawdata() == expected.rawdata());
+			}
+		}
+	}
+	FieldSet set(names);
+	CHECK(set.size() == names.size());
+	CHECK(set.find("missing", 7) == 20);
+	CHECK(set.find("nope", 4) == -1);
+	vector<bsonelement> fields(set.size());
+	// the name repeated at the end is set too
+	CHECK(set.getFields(obj, fields.data()) == 21);
+	CHECK(fields[20].eoo());
+	CHECK(fields[21].rawdata() == fields[3].rawdata());
+
+	// an int32 named "abc" whose name has no NUL before the EOO
+	const char bytes[] = { 9, 0, 0, 0, 0x10, 'a', 'b', 'c', 0 };
+	unique_ptr<char[]> exact(new char[sizeof(bytes)]);
+	memcpy(exact.get(), bytes, sizeof(bytes));
+	bsonobj broken(exact.get());
+	CHECK(broken.getField("abc").eoo());
+	const char* abc[] = { "abc", "b", "c", "d", "e", "f", "g", "h", "i" };
+	bsonelement found[9];
+	broken.getFields(1, abc, found);
+	CHECK(found[0].eoo());
+	broken.getFields(9, abc, found);
+	CHECK(found[0].eoo());
+	CHECK(FieldSet(9, abc).getFields(broken, found) == 0);
+	return passed();
+}
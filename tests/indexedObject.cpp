@@ -0,0 +1,95 @@
+// indexedbsonobj finds what bsonobj::getField() does, whether the object is small enough to be
+// scanned or goes through the hash table: hits, misses, the first of repeated names, and dotted
+// names of which only the first part is looked up in the index.
+
+#include "ofxBson.h"
+#include "bson/indexedbsonobj.h"
+#include "check.h"
+
+using namespace _bson;
+
+namespace {
+	// the same element as the scan, or none for both
+	bool sameAsScan(const indexedbsonobj& indexed, const string& name) {
+		bsonelement found = indexed.getField(name);
+		bsonelement scanned = indexed.obj().getField(name);
+		return found.eoo() == scanned.eoo() && (found.eoo() || found.rawdata() == scanned.rawdata()) &&
+			indexed.hasField(name) == !scanned.eoo() && indexed[name].rawdata() == found.rawdata();
+	}
+
+	// fields "f0" to "f<count - 1>", then "f1" again, an object, an array and a name with a dot
+	void fill(bsonobjbuilder& b, const bsonobj& sub, const bsonobj& list, int count) {
+		for (int i = 0; i < count; i++) {
+			b.append("f" + ofToString(i), i);
+		}
+		b.append("f1", string("repeated"));
+		b.append("sub", sub);
+		b.appendArray("list", list);
+		b.append("dot.ted", string("whole"));
+	}
+}
+
+int main() {
+	bsonobjbuilder inner;
+	inner.append("y", 2);
+	bsonobjbuilder subBuilder;
+	subBuilder.append("x", 1);
+	subBuilder.append("inner", inner.obj());
+	bsonobj sub = subBuilder.obj();
+	bsonobjbuilder listBuilder;
+	listBuilder.append("0", string("first"));
+	listBuilder.append("1", string("second"));
+	bsonobj list = listBuilder.obj();
+
+	bsonobjbuilder smallBuilder, bigBuilder;
+	fill(smallBuilder, sub, list, 4);
+	fill(bigBuilder, sub, list, 100);
+	bsonobj small = smallBuilder.obj();
+	bsonobj big = bigBuilder.obj();
+
+	for (auto obj : { small, big }) {
+		indexedbsonobj indexed(obj);
+		CHECK(!indexed.indexed());
+		indexed.buildIndex();
+		CHECK(indexed.indexed() == (obj.nFields() >= indexedbsonobj::MinIndexedFields));
+		indexed.buildIndex();
+
+		// hits
+		for (int i = 0; i < 4; i++) {
+			CHECK(sameAsScan(indexed, "f" + ofToString(i)));
+			CHECK(indexed.getField("f" + ofToString(i)).numberInt() == i);
+		}
+		CHECK(sameAsScan(indexed, "sub"));
+		CHECK(sameAsScan(indexed, "list"));
+		CHECK(sameAsScan(indexed, "dot.ted"));
+
+		// misses, among them prefixes and extensions of names there
+		for (const char* name : { "", "f", "f00", "f1x", "su", "subs", "missing", "f99999" }) {
+			CHECK(sameAsScan(indexed, name));
+			CHECK(indexed.getField(name).eoo());
+		}
+
+		// the first of two fields of the same name
+		CHECK(indexed.getField("f1").type() == NumberInt);
+		CHECK(indexed.getField("f1").numberInt() == 1);
+
+		// a dotted name: the first part through the index, the rest scanned
+		CHECK(indexed.getFieldDotted("sub.x").numberInt() == 1);
+		CHECK(indexed.getFieldDotted("sub.inner.y").numberInt() == 2);
+		CHECK(indexed.getFieldDotted("list.1").str() == "second");
+		CHECK(indexed.getFieldDotted("dot.ted").str() == "whole");
+		CHECK(indexed.getFieldDotted("f0").numberInt() == 0);
+		CHECK(indexed.getFieldDotted("sub.missing").eoo());
+		CHECK(indexed.getFieldDotted("missing.x").eoo());
+		CHECK(indexed.getFieldDotted("f0.x").eoo());
+		CHECK(indexed.getFieldDotted("dot.x").eoo());
+		CHECK(indexed.getFieldDotted("sub.x").rawdata() == obj.getFieldDotted("sub.x").rawdata());
+	}
+
+	// nothing to find in an empty object
+	indexedbsonobj empty((bsonobj()));
+	CHECK(empty.getField("f0").eoo());
+	CHECK(!empty.indexed());
+	CHECK(empty.getFieldDotted("sub.x").eoo());
+	return passed();
+}
@@ -0,0 +1,66 @@
+// the tree a loadAsync() replaces is freed by the worker: swapping the loaded one in on the
+// main thread takes far less than freeing a big tree would.
+
+#include <chrono>
+
+#include "ofxBson.h"
+#include "check.h"
+
+namespace {
+	const string path = "loadAsyncRelease.bson";
+
+	typedef std::chrono::steady_clock Clock;
+
+	double millisSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	void fill(ofxBson& b) {
+		for (int i = 0; i < 100000; i++) {
+			string name = "f" + ofToString(i);
+			b.addChild(name);
+			b.setTo(name);
+			b.setValue("n", (int32_t)i);
+			b.setValue("text", string("text"));
+			b.setToParent();
+		}
+	}
+
+	struct Inspected : ofxBson {
+		static weak_ptr<BSONNode> rootOf(const ofxBson& b) { return b.*&Inspected::root; }
+	};
+}
+
+int main() {
+	{
+		ofxBson small;
+		small.setValue("loaded", true);
+		CHECK(small.save(path));
+	}
+
+	auto start = Clock::now();
+	{
+		ofxBson freed;
+		fill(freed);
+		start = Clock::now();
+	}
+	double freeing = millisSince(start);
+
+	ofxBson b;
+	fill(b);
+	auto old = Inspected::rootOf(b);
+	auto loaded = b.loadAsync(path);
+	double swapping = 0;
+	while (loaded.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+		start = Clock::now();
+		b.applyAsyncLoads();
+		swapping = millisSince(start);
+	}
+	CHECK(loaded.get());
+	CHECK(b.getBoolValue("loaded"));
+	CHECK(swapping < freeing / 4);
+	// once the worker is done with the queue, the old tree is gone
+	CHECK(b.saveAsync(path).get());
+	CHECK(old.expired());
+	return passed();
+}
@@ -0,0 +1,102 @@
+// a bsonobj is a forward range of its elements, EOO excluded: range-for, std::distance() and
+// std::find_if() see the same nFields() elements as more()/next(), in empty, nested and array
+// objects alike, and so does prefetched().
+
+#include "ofxBson.h"
+#include "bson/bsonobjiterator.h"
+#include "check.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace _bson;
+
+namespace {
+	// the range gives the elements more()/next() do, in order
+	bool walksLikeNext(const bsonobj& obj) {
+		bsonobjiterator it(obj);
+		int n = 0;
+		for (bsonelement e : obj) {
+			if (!it.more() || it.next().rawdata() != e.rawdata() || e.eoo()) {
+				return false;
+			}
+			n++;
+		}
+		for (bsonelement e : obj.prefetched(16)) {
+			n--;
+			(void)e;
+		}
+		return !it.more() && n == 0 &&
+			std::distance(obj.begin(), obj.end()) == obj.nFields() &&
+			std::distance(obj.prefetched().begin(), obj.prefetched().end()) == obj.nFields();
+	}
+
+	// and the std algorithms find what getField() does
+	bool findsLikeGetField(const bsonobj& obj, const string& name) {
+		auto found = std::find_if(obj.begin(), obj.end(), [&](const bsonelement& e) { return name == e.fieldName(); });
+		bsonelement expected = obj.getField(name);
+		return expected.eoo() ? found == obj.end() : (found != obj.end() && (*found).rawdata() == expected.rawdata());
+	}
+
+	// every object and array below obj too
+	bool walksNested(const bsonobj& obj) {
+		if (!walksLikeNext(obj)) {
+			return false;
+		}
+		for (bsonelement e : obj) {
+			if ((e.type() == Object || e.type() == Array) && !walksNested(e.object())) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main() {
+	bsonobj empty;
+	CHECK(empty.nFields() == 0);
+	CHECK(empty.begin() == empty.end());
+	CHECK(walksLikeNext(empty));
+	CHECK(findsLikeGetField(empty, "a"));
+	for (bsonelement e : empty) {
+		(void)e;
+		CHECK(false);
+	}
+
+	bsonobjbuilder emptyBuilder;
+	bsonobj emptySub = emptyBuilder.obj();
+	bsonobjbuilder innerBuilder;
+	innerBuilder.append("y", 2);
+	innerBuilder.append("z", string("zed"));
+	bsonobj inner = innerBuilder.obj();
+	bsonobjbuilder listBuilder;
+	listBuilder.append("0", 1);
+	listBuilder.append("1", inner);
+	listBuilder.append("2", string("two"));
+	bsonobj list = listBuilder.obj();
+	bsonobjbuilder builder;
+	builder.append("a", 1);
+	builder.append("none", emptySub);
+	builder.append("inner", inner);
+	builder.appendArray("list", list);
+	builder.append("b", 0.5);
+	bsonobj obj = builder.obj();
+
+	CHECK(obj.nFields() == 5);
+	CHECK(walksNested(obj));
+	for (const char* name : { "a", "none", "inner", "list", "b", "missing", "" }) {
+		CHECK(findsLikeGetField(obj, name));
+	}
+	CHECK(findsLikeGetField(list, "2"));
+	CHECK(findsLikeGetField(list, "3"));
+	CHECK(std::count_if(list.begin(), list.end(), [](const bsonelement& e) { return e.type() == Object; }) == 1);
+
+	// iterators of different objects are not equal, default constructed ones are
+	CHECK(obj.begin() != inner.begin());
+	CHECK(bsonobjiterator() == bsonobjiterator());
+	auto it = obj.begin();
+	CHECK(it++ == obj.begin());
+	CHECK(it != obj.begin());
+	CHECK(std::next(obj.begin(), obj.nFields()) == obj.end());
+	return passed();
+}
@@ -0,0 +1,62 @@
+// delta() follows the change events of the group: it writes the parameters changed since the
+// previous one, in the groups they are in, and nothing when nothing changed.
+
+#include "ofxBsonParameterPlan.h"
+#include "check.h"
+
+int main() {
+	ofParameter<int> count("count", 1);
+	ofParameter<float> speed("speed", 0.5f);
+	ofParameter<string> label("label", "start");
+	ofParameter<bool> enabled("enabled", true);
+	ofParameterGroup inner;
+	inner.setName("inner");
+	inner.add(label);
+	inner.add(enabled);
+	ofParameterGroup settings;
+	settings.setName("settings");
+	settings.add(count);
+	settings.add(speed);
+	settings.add(inner);
+
+	ofxBsonParameterPlan plan(settings);
+	// the first delta holds everything
+	_bson::bsonobj all = plan.delta();
+	CHECK(all["settings"].Obj().nFields() == 3);
+	CHECK(all["settings"].Obj()["inner"].Obj()["label"].str() == "start");
+
+	CHECK(plan.delta().isEmpty());
+
+	label = "moved";
+	_bson::bsonobj changed = plan.delta();
+	_bson::bsonobj settingsPatch = changed["settings"].Obj();
+	CHECK(settingsPatch.nFields() == 1);
+	CHECK(settingsPatch["inner"].Obj().nFields() == 1);
+	CHECK(settingsPatch["inner"].Obj()["label"].str() == "moved");
+
+	// changed and changed back before the next delta: nothing to send
+	count = 2;
+	count = 1;
+	CHECK(plan.delta().isEmpty());
+
+	count = 3;
+	speed = 2.f;
+	changed = plan.delta();
+	CHECK(changed["settings"].Obj().nFields() == 2);
+	CHECK(changed["settings"].Obj()["count"].numberInt() == 3);
+
+	// the patch applies to another copy of the group
+	ofParameter<int> otherCount("count", 0);
+	ofParameter<float> otherSpeed("speed", 0);
+	ofParameterGroup other;
+	other.setName("settings");
+	other.add(otherCount);
+	other.add(otherSpeed);
+	ofxBsonParameterPlan receiver(other);
+	receiver.applyDelta(changed);
+	CHECK(otherCount.get() == 3 && otherSpeed.get() == 2.f);
+
+	plan.resetDelta();
+	CHECK(plan.delta()["settings"].Obj().nFields() == 3);
+	return passed();
+}
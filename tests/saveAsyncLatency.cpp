@@ -0,0 +1,85 @@
+// saveAsync() only takes a snapshot on the calling thread: the main thread must not wait for
+// the file to be written. saves and loads run in order on one worker, so several saves to the
+// same file end with the last one, and every save mode writes the same bytes.
+
+#include <chrono>
+
+#include "ofxBson.h"
+#include "check.h"
+
+namespace {
+	const string path = "saveAsyncLatency.bson";
+	const int fields = 20000;
+
+	typedef std::chrono::steady_clock Clock;
+
+	double millisSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// the typical time, whatever the scheduler did to one of the runs
+	double median(vector<double> times) {
+		sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	void fill(ofxBson& b) {
+		for (int i = 0; i < fields; i++) {
+			string name = "f" + ofToString(i);
+			b.addChild(name);
+			b.setTo(name);
+			b.setValue("text", string(100, 'a' + i % 26));
+			b.setValue("n", (int32_t)i);
+			b.setToParent();
+		}
+	}
+
+	int savedRevision() {
+		ofxBson b;
+		return b.load(path) ? b.getIntValue("revision") : -1;
+	}
+}
+
+int main() {
+	for (int mode = 0; mode < 3; mode++) {
+		ofxBson b;
+		b.setIncrementalSave(mode == 1);
+		b.setParallelSave(mode == 2, 2);
+		fill(b);
+
+		auto start = Clock::now();
+		b.save(path);
+		double saving = millisSince(start);
+
+		vector<double> snapshotting;
+		for (int i = 0; i < 5; i++) {
+			b.setValue("revision", -1);
+			start = Clock::now();
+			b.snapshot();
+			snapshotting.push_back(millisSince(start));
+		}
+
+		vector<std::future<bool>> saves;
+		vector<double> blocked;
+		for (int revision = 0; revision < 5; revision++) {
+			b.setValue("revision", (int32_t)revision);
+			start = Clock::now();
+			saves.push_back(b.saveAsync(path));
+			blocked.push_back(millisSince(start));
+		}
+		for (auto& saved : saves) {
+			CHECK(saved.get());
+		}
+		// queued one after the other: the last one asked for is the one on disk
+		CHECK(savedRevision() == 4);
+		// the snapshot is all the caller waits for, never the writing
+		CHECK(median(blocked) <= median(snapshotting) * 2 + 1);
+		CHECK(*max_element(blocked.begin(), blocked.end()) < saving / 2);
+
+		ofxBson loaded;
+		CHECK(loaded.load(path));
+		CHECK(loaded.setTo("f" + ofToString(fields - 1)));
+		CHECK(loaded.getIntValue("n") == fields - 1);
+	}
+	return passed();
+}
@@ -0,0 +1,90 @@
+// incremental saves keep the bytes they wrote as the cache of the document: containers copied
+// along with an untouched parent must move to the new bytes too, so the buffers of older saves
+// are released instead of piling up.
+
+#include "ofxBson.h"
+#include "check.h"
+
+namespace {
+	const string path = "saveCacheBuffers.bson";
+	const string copyPath = "saveCacheBuffersCopy.bson";
+	const int groups = 8;
+
+	// the buffer the cached bytes of the root live in
+	struct Saved : public ofxBson {
+		shared_ptr<const void> rootBacking() { return root->getObject()->getBacking(); }
+	};
+
+	bool visit(ofxBson& b, int i) {
+		if (!b.setTo("g" + ofToString(i)) || !b.setTo("inner") || !b.setTo("list")) {
+			return false;
+		}
+		b.setToParent();
+		b.setToParent();
+		b.setToParent();
+		return true;
+	}
+}
+
+int main() {
+	{
+		ofxBson b;
+		for (int i = 0; i < groups; i++) {
+			string name = "g" + ofToString(i);
+			b.addChild(name);
+			b.setTo(name);
+			b.addChild("inner");
+			b.setTo("inner");
+			b.setValue("x", (double)i);
+			b.addArray("list");
+			b.setTo("list");
+			b.pushValue(1.0);
+			b.pushObject();
+			b.setToParent();
+			b.setToParent();
+			b.setToParent();
+		}
+		CHECK(b.save(path));
+	}
+	for (int lazy = 0; lazy < 2; lazy++) {
+		Saved b;
+		b.setLazyLoad(lazy != 0);
+		b.setIncrementalSave(true);
+		CHECK(b.load(path));
+		for (int i = 0; i < groups; i++) {
+			CHECK(visit(b, i));
+		}
+		vector<weak_ptr<const void>> buffers;
+		CHECK(b.save(copyPath));
+		buffers.push_back(b.rootBacking());
+		// each save changes another group, copying the others as they were
+		for (int i = 0; i < groups - 1; i++) {
+			CHECK(b.setTo("g" + ofToString(i)));
+			CHECK(b.setTo("inner"));
+			b.setValue("x", 100.0 + i);
+			b.setToParent();
+			b.setToParent();
+			CHECK(b.save(copyPath));
+			buffers.push_back(b.rootBacking());
+		}
+		int alive = 0;
+		for (auto& w : buffers) {
+			alive += !w.expired();
+		}
+		CHECK(alive == 1);
+
+		ofxBson c;
+		CHECK(c.load(copyPath));
+		for (int i = 0; i < groups; i++) {
+			CHECK(c.setTo("g" + ofToString(i)));
+			CHECK(c.setTo("inner"));
+			CHECK(c.getDoubleValue("x") == (i < groups - 1 ? 100.0 + i : i));
+			CHECK(c.setTo("list"));
+			CHECK(c.getSize() == 2);
+			c.setToParent();
+			c.setToParent();
+			c.setToParent();
+		}
+	}
+	return passed();
+}
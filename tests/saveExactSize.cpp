@@ -0,0 +1,31 @@
+// incremental saves build into a buffer of exactly the serialized size. every append has to
+// stay within it: a builder that reserves more than it writes reallocates at the very end of
+// a big document, and past 64 MB it is not allowed to grow at all.
+
+#include "ofxBson.h"
+#include "check.h"
+
+int main() {
+	ofxBson b;
+	b.setIncrementalSave(true);
+	b.setValue("big", string(70 * 1024 * 1024, 'x'));
+	b.addArray("list");
+	b.setTo("list");
+	b.pushValue(true);
+	b.setToParent();
+
+	ofBuffer out;
+	bool saved = false;
+	try {
+		saved = b.saveToBuffer(out);
+	} catch (...) {
+	}
+	CHECK(saved);
+	CHECK((long long)out.size() == b.getSerializedSize());
+
+	ofxBson loaded;
+	CHECK(loaded.loadFromBuffer(out.getData(), out.size()));
+	CHECK(loaded.getValue("big").size() == 70 * 1024 * 1024);
+	CHECK(loaded.setTo("list") && loaded.getBoolValue(0));
+	return passed();
+}
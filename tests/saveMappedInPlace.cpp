@@ -0,0 +1,68 @@
+// a lazily loaded mapped document saved back over its own file: the file must not be cut
+// short while the save still reads the untouched parts through the mapping, and a save that
+// fails must leave the file as it was.
+
+#include "ofxBson.h"
+#include "check.h"
+
+namespace {
+	const string path = "saveMappedInPlace.bson";
+	const int fields = 2000;
+
+	bool fill() {
+		ofxBson b;
+		for (int i = 0; i < fields; i++) {
+			string name = "f" + ofToString(i);
+			b.addChild(name);
+			b.setTo(name);
+			b.setValue("text", string(200, 'a' + i % 26));
+			b.setValue("n", (int32_t)i);
+			b.setToParent();
+		}
+		return b.save(path);
+	}
+
+	bool intact(int edited) {
+		ofxBson b;
+		if (!b.load(path)) {
+			return false;
+		}
+		for (int i = 0; i < fields; i++) {
+			if (!b.setTo("f" + ofToString(i))) {
+				return false;
+			}
+			bool ok = b.getIntValue("n") == (i == 0 ? edited : i) && b.getValue("text") == string(200, 'a' + i % 26);
+			b.setToParent();
+			if (!ok) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main() {
+	enum { Streamed, Incremental, Parallel };
+	for (int mode = Streamed; mode <= Parallel; mode++) {
+		CHECK(fill());
+		ofxBson b;
+		b.setLazyLoad(true);
+		b.setIncrementalSave(mode == Incremental);
+		b.setParallelSave(mode == Parallel, 2);
+		CHECK(b.loadMapped(path));
+		CHECK(b.setTo("f0"));
+		b.setValue("n", (int32_t)-1);
+		b.setToParent();
+		CHECK(b.save(path));
+		// saved twice: the second save reads from the first one's bytes, or the mapping again
+		CHECK(b.save(path));
+		CHECK(intact(-1));
+	}
+
+	// a save into a directory that does not exist leaves nothing behind and the old file alone
+	ofxBson b;
+	b.setValue("x", (int32_t)1);
+	CHECK(!b.save("no/such/dir/" + path));
+	CHECK(intact(-1));
+	return passed();
+}
@@ -0,0 +1,69 @@
+// setting a value of the same type updates its node in place: the paths resolved before keep
+// their cached resolution and read the new value. snapshots taken before must not see it.
+
+#include "ofxBson.h"
+#include "check.h"
+
+namespace {
+	struct Inspected : public ofxBson {
+		uint64_t version() const { return doc->version; }
+	};
+}
+
+int main() {
+	Inspected b;
+	b.setIncrementalSave(true);
+	b.addChild("scene");
+	b.setTo("scene");
+	b.setValue("speed", 1.0);
+	b.setValue("name", string("first"));
+	b.setToParent();
+
+	ofxBson::Path speed("scene.speed");
+	ofxBson::Path name("scene.name");
+	CHECK(b.getDoubleValue(speed) == 1.0);
+	CHECK(b.getValue(name) == "first");
+
+	// saved once, so the next save has to notice the change below a cached object
+	ofBuffer before;
+	CHECK(b.saveToBuffer(before));
+
+	uint64_t version = b.version();
+	b.setTo("scene");
+	b.setValue("speed", 2.0);
+	b.setValue("name", string("second"));
+	b.setToParent();
+	CHECK(b.version() == version);
+	CHECK(b.getDoubleValue(speed) == 2.0);
+	CHECK(b.getValue(name) == "second");
+
+	ofBuffer after;
+	CHECK(b.saveToBuffer(after));
+	ofxBson loaded;
+	CHECK(loaded.loadFromBuffer(after.getData(), after.size()));
+	CHECK(loaded.getDoubleValue(speed) == 2.0);
+	CHECK(loaded.getValue(name) == "second");
+
+	// the snapshot keeps the values it was taken with
+	auto view = b.snapshot();
+	b.setTo("scene");
+	b.setValue("speed", 3.0);
+	b.setToParent();
+	CHECK(view->getDoubleValue(speed) == 2.0);
+	CHECK(b.getDoubleValue(speed) == 3.0);
+	// the copies made for the edit are the document's own now
+	version = b.version();
+	b.setTo("scene");
+	b.setValue("speed", 4.0);
+	b.setToParent();
+	CHECK(b.version() == version);
+	CHECK(view->getDoubleValue(speed) == 2.0);
+
+	// another type replaces the node, and the paths resolve again
+	b.setTo("scene");
+	b.setValue("speed", (int32_t)5);
+	b.setToParent();
+	CHECK(b.version() != version);
+	CHECK(b.getIntValue(speed) == 5);
+	return passed();
+}
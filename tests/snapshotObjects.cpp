@@ -0,0 +1,50 @@
+// objects with a guid kept in lazily loaded containers must still be found once the document
+// was frozen by snapshot() or saveAsync().
+
+#include "ofxBson.h"
+#include "check.h"
+
+namespace {
+	struct Object {};
+	const string guid = "00000000-0000-4000-8000-000000000001";
+	const string path = "snapshotObjects.bson";
+
+	void setConstructor(ofxBson& b) {
+		b.setConstructor("Object", [](ofxBson&) { return make_shared<Object>(); });
+	}
+}
+
+int main() {
+	{
+		// the object sits two containers below the root, so a lazy load leaves it unread
+		ofxBson b;
+		bool existing;
+		b.addChild("wrap");
+		b.setTo("wrap");
+		b.addArray("objects");
+		b.setTo("objects");
+		b.pushGUIDObject(guid, "Object", existing);
+		b.setToParent();
+		b.setToParent();
+		CHECK(b.save(path));
+	}
+	for (int freeze = 0; freeze < 3; freeze++) {
+		ofxBson b;
+		b.setLazyLoad(true);
+		CHECK(b.load(path));
+		setConstructor(b);
+		shared_ptr<ofxBson> view;
+		if (freeze == 1) {
+			view = b.snapshot();
+		} else if (freeze == 2) {
+			CHECK(b.saveAsync(path).get());
+		}
+		CHECK(b.getConstructedObjectByGUID<Object>(guid));
+		CHECK(b.constructAll() == 1);
+		if (view) {
+			setConstructor(*view);
+			CHECK(view->getConstructedObjectByGUID<Object>(guid));
+		}
+	}
+	return passed();
+}
@@ -0,0 +1,60 @@
+// snapshot() shares the store of objects and the constructors with the view instead of copying
+// them: whichever side changes them first gets a copy of its own.
+
+#include "ofxBson.h"
+#include "check.h"
+
+#include <cstdio>
+
+namespace {
+	struct Object {};
+
+	string guidOf(int i) {
+		char guid[37];
+		snprintf(guid, sizeof(guid), "00000000-0000-4000-8000-%012d", i);
+		return guid;
+	}
+
+	// reaches the members of any ofxBson, the views included
+	struct Inspected : ofxBson {
+		static const void* storeOf(const ofxBson& b) { return (b.*&Inspected::storedObjects).get(); }
+		static const void* constructorsOf(const ofxBson& b) { return (b.*&Inspected::constructors).get(); }
+	};
+}
+
+int main() {
+	ofxBson b;
+	bool existing;
+	b.setValue("name", string("before"));
+	b.addArray("objects");
+	b.setTo("objects");
+	for (int i = 0; i < 1000; i++) {
+		b.pushGUIDObject(guidOf(i), "Object", existing);
+	}
+	b.setToParent();
+	b.setConstructor("Object", [](ofxBson&) { return make_shared<Object>(); });
+
+	auto view = b.snapshot();
+	CHECK(Inspected::storeOf(*view) == Inspected::storeOf(b));
+	CHECK(Inspected::constructorsOf(*view) == Inspected::constructorsOf(b));
+
+	// values outside the objects leave the store alone
+	b.setValue("name", string("after"));
+	CHECK(Inspected::storeOf(*view) == Inspected::storeOf(b));
+	CHECK(view->getValue("name") == "before");
+	CHECK(view->getConstructedObjectByGUID<Object>(guidOf(0)));
+
+	// a new object is stored in a copy: the view doesn't see it
+	b.setTo("objects");
+	b.pushGUIDObject(guidOf(1000), "Object", existing);
+	b.setToParent();
+	CHECK(Inspected::storeOf(*view) != Inspected::storeOf(b));
+	CHECK(b.getConstructedObjectByGUID<Object>(guidOf(1000)));
+	CHECK(!view->getConstructedObjectByGUID<Object>(guidOf(1000)));
+	CHECK(view->getConstructedObjectByGUID<Object>(guidOf(999)));
+
+	// and so is a constructor set afterwards
+	b.setConstructor("Other", [](ofxBson&) { return make_shared<Object>(); });
+	CHECK(Inspected::constructorsOf(*view) != Inspected::constructorsOf(b));
+	return passed();
+}
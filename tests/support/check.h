@@ -0,0 +1,15 @@
+#pragma once
+
+// what every test reports: failed checks on stderr, "ok" on stdout once all passed.
+// the exit code is what ctest goes by.
+
+#include <iostream>
+
+/** fails the test, from main() or any helper returning int, when x does not hold */
+#define CHECK(x) do { if (!(x)) { std::cerr << __FILE__ << ":" << __LINE__ << ": " #x " failed\n"; return 1; } } while (0)
+
+/** what main() returns once every check passed */
+inline int passed() {
+	std::cout << "ok\n";
+	return 0;
+}
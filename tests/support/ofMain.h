@@ -0,0 +1,223 @@
+#pragma once
+
+// the parts of openFrameworks the addon uses, enough to build and run the tests without it.
+// an app links the addon against the real ofMain.h instead.
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+using namespace std;
+
+template <class T>
+string ofToString(const T& value) {
+	ostringstream out;
+	out << value;
+	return out.str();
+}
+
+// no data folder here: paths are taken as they are
+inline string ofToDataPath(const string& path, bool absolute = false) {
+	return path;
+}
+
+class ofBuffer {
+public:
+	ofBuffer() {}
+	ofBuffer(const char* data, size_t size) : bytes(data, data + size) {}
+	void allocate(size_t size) { bytes.assign(size, 0); }
+	void set(const char* data, size_t size) { bytes.assign(data, data + size); }
+	void append(const char* data, size_t size) { bytes.insert(bytes.end(), data, data + size); }
+	void clear() { bytes.clear(); }
+	char* getData() { return bytes.data(); }
+	const char* getData() const { return bytes.data(); }
+	char* getBinaryBuffer() { return bytes.data(); }
+	const char* getBinaryBuffer() const { return bytes.data(); }
+	size_t size() const { return bytes.size(); }
+private:
+	vector<char> bytes;
+};
+
+class ofFile : public fstream {
+public:
+	enum Mode { Reference, ReadOnly, WriteOnly, ReadWrite, Append };
+	ofFile() {}
+	ofFile(const string& path, Mode mode = ReadOnly, bool binary = true) { open(path, mode, binary); }
+	bool open(const string& path, Mode mode = ReadOnly, bool binary = true) {
+		ios_base::openmode m = mode == ReadOnly ? ios::in : ios::out | ios::trunc;
+		fstream::open(ofToDataPath(path), binary ? m | ios::binary : m);
+		return is_open();
+	}
+	ofBuffer readToBuffer() {
+		ostringstream out;
+		out << rdbuf();
+		string bytes = out.str();
+		return ofBuffer(bytes.data(), bytes.size());
+	}
+	bool writeFromBuffer(const ofBuffer& buffer) {
+		write(buffer.getData(), buffer.size());
+		return good();
+	}
+};
+
+class ofEventArgs {};
+
+template <class T>
+class ofEvent {
+public:
+	template <class L>
+	void add(L* listener, void (L::*method)(T&)) {
+		listeners.push_back(make_pair((void*)listener, [listener, method](T& args) { (listener->*method)(args); }));
+	}
+	template <class L>
+	void remove(L* listener, void (L::*method)(T&)) {
+		for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+			if (it->first == (void*)listener) {
+				listeners.erase(it);
+				return;
+			}
+		}
+	}
+	void notify(T& args) {
+		auto copy = listeners;
+		for (auto& l : copy) {
+			l.second(args);
+		}
+	}
+private:
+	vector<pair<void*, function<void(T&)>>> listeners;
+};
+
+template <class T, class L>
+void ofAddListener(ofEvent<T>& event, L* listener, void (L::*method)(T&)) {
+	event.add(listener, method);
+}
+
+template <class T, class L>
+void ofRemoveListener(ofEvent<T>& event, L* listener, void (L::*method)(T&)) {
+	event.remove(listener, method);
+}
+
+template <class T>
+void ofNotifyEvent(ofEvent<T>& event, T& args) {
+	event.notify(args);
+}
+
+struct ofCoreEvents {
+	ofEvent<ofEventArgs> update;
+};
+
+inline ofCoreEvents& ofEvents() {
+	static ofCoreEvents events;
+	return events;
+}
+
+class ofParameterGroup;
+template <class T> class ofParameter;
+
+class ofAbstractParameter {
+public:
+	virtual ~ofAbstractParameter() {}
+	virtual string getName() const = 0;
+	virtual void setName(const string& name) = 0;
+	virtual string getEscapedName() const { return getName(); }
+	virtual string toString() const = 0;
+	virtual void fromString(const string& str) = 0;
+	virtual string type() const { return typeid(*this).name(); }
+	virtual bool isSerializable() const { return true; }
+	template <class T> ofParameter<T>& cast() { return static_cast<ofParameter<T>&>(*this); }
+	template <class T> const ofParameter<T>& cast() const { return static_cast<const ofParameter<T>&>(*this); }
+	ofParameterGroup& castGroup();
+	const ofParameterGroup& castGroup() const;
+	// the groups the parameter was added to, told when it changes
+	vector<ofParameterGroup*> parents;
+protected:
+	void notifyParents();
+};
+
+template <class T>
+class ofParameter : public ofAbstractParameter {
+public:
+	ofParameter() : value() {}
+	ofParameter(const string& name, const T& value) : name(name), value(value) {}
+	const T& get() const { return value; }
+	void set(const T& v) {
+		value = v;
+		notifyParents();
+	}
+	ofParameter& operator=(const T& v) { set(v); return *this; }
+	operator const T&() const { return value; }
+	string getName() const { return name; }
+	void setName(const string& n) { name = n; }
+	string toString() const { return ofToString(value); }
+	void fromString(const string& str) {
+		istringstream in(str);
+		in >> value;
+		notifyParents();
+	}
+private:
+	string name;
+	T value;
+};
+
+template <>
+inline void ofParameter<string>::fromString(const string& str) {
+	set(str);
+}
+
+class ofParameterGroup : public ofAbstractParameter {
+public:
+	ofParameterGroup() {}
+	string getName() const { return name; }
+	void setName(const string& n) { name = n; }
+	string toString() const { return ""; }
+	void fromString(const string& str) {}
+	void add(ofAbstractParameter& parameter) {
+		parameters.push_back(&parameter);
+		parameter.parents.push_back(this);
+	}
+	// fired for every change of a parameter in the group or in one of its subgroups
+	ofEvent<ofAbstractParameter>& parameterChangedE() { return changed; }
+	void notifyParameterChanged(ofAbstractParameter& parameter) {
+		ofNotifyEvent(changed, parameter);
+		for (auto parent : parents) {
+			parent->notifyParameterChanged(parameter);
+		}
+	}
+	size_t size() const { return parameters.size(); }
+	vector<ofAbstractParameter*>::const_iterator begin() const { return parameters.begin(); }
+	vector<ofAbstractParameter*>::const_iterator end() const { return parameters.end(); }
+private:
+	string name;
+	vector<ofAbstractParameter*> parameters;
+	ofEvent<ofAbstractParameter> changed;
+};
+
+inline void ofAbstractParameter::notifyParents() {
+	for (auto parent : parents) {
+		parent->notifyParameterChanged(*this);
+	}
+}
+
+inline ofParameterGroup& ofAbstractParameter::castGroup() { return static_cast<ofParameterGroup&>(*this); }
+inline const ofParameterGroup& ofAbstractParameter::castGroup() const { return static_cast<const ofParameterGroup&>(*this); }
+
+class ofBaseFileSerializer {
+public:
+	virtual ~ofBaseFileSerializer() {}
+	virtual void serialize(const ofAbstractParameter& parameter) = 0;
+	virtual void deserialize(ofAbstractParameter& parameter) = 0;
+	virtual bool load(const string& path) = 0;
+	virtual bool save(const string& path) = 0;
+};
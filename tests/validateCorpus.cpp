@@ -0,0 +1,137 @@
+// validateBSON() rejects every buffer of corpus/malformed, each broken in one way, and
+// loadFromBuffer() refuses them without reading past their end. every prefix of a valid
+// document is rejected too, and the documents ofxBson writes are accepted. the loaders
+// reading files reject a malformed one the same way.
+
+#include "ofxBson.h"
+#include "bson/bson_validate.h"
+#include "check.h"
+
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace {
+	const char* malformed[] = {
+		"empty",
+		"shorter_than_header",
+		"size_past_buffer",
+		"size_below_minimum",
+		"size_negative",
+		"missing_eoo",
+		"eoo_before_end",
+		"field_name_unterminated",
+		"unknown_type",
+		"int32_past_object",
+		"double_past_object",
+		"string_size_zero",
+		"string_size_negative",
+		"string_size_past_object",
+		"string_unterminated",
+		"object_size_past_parent",
+		"object_size_below_minimum",
+		"object_missing_eoo",
+		"array_size_past_parent",
+		"bindata_size_negative",
+		"bindata_size_past_object",
+		"bindata_old_inner_size",
+		"bool_not_0_or_1",
+		"regex_unterminated",
+		"dbref_missing_oid",
+		"code_with_scope_bad_scope",
+		"nested_too_deep",
+	};
+
+	bool read(const string& path, vector<char>& bytes) {
+		ifstream in(path, ios::binary);
+		bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+		return !in.bad() && in.is_open();
+	}
+
+	// the size of the buffer exactly, so that reading one byte too far is caught by sanitizers
+	bool rejected(const vector<char>& bytes) {
+		unique_ptr<char[]> exact(new char[bytes.size() + 1]);
+		memcpy(exact.get(), bytes.data(), bytes.size());
+		ofxBson b;
+		return !_bson::validateBSON(bytes.empty() ? 0 : exact.get(), bytes.size()).isOK() &&
+			!b.loadFromBuffer(exact.get(), bytes.size(), ofxBson::BorrowBuffer);
+	}
+
+	bool loadsFile(const string& path, int loader) {
+		ofxBson b;
+		switch (loader) {
+		case 0:
+			return b.load(path);
+		case 1:
+			return b.loadMapped(path);
+		default:
+		{
+			auto loaded = b.loadAsync(path);
+			while (loaded.wait_for(chrono::milliseconds(1)) != future_status::ready) {
+				b.applyAsyncLoads();
+			}
+			return loaded.get();
+		}
+		}
+	}
+}
+
+int main() {
+	vector<char> bytes;
+	for (auto name : malformed) {
+		CHECK(read(string(CORPUS_DIR "/malformed/") + name + ".bson", bytes));
+		if (!rejected(bytes)) {
+			cerr << name << " was accepted\n";
+			return 1;
+		}
+	}
+
+	ofxBson b;
+	bool existing;
+	b.setValue("text", string("some text"));
+	b.setValue("number", 1.5);
+	b.setBuffer("buffer", ofBuffer("bytes", 5));
+	b.addArray("list");
+	b.setTo("list");
+	b.pushGUIDObject("00000000-0000-4000-8000-000000000003", "Object", existing);
+	b.setTo(0);
+	b.setValue("inner", (int32_t)1);
+	b.setToParent();
+	b.setToParent();
+	vector<char> valid;
+	CHECK(b.saveTo(valid));
+	CHECK(_bson::validateBSON(valid.data(), valid.size()).isOK());
+	for (size_t n = 0; n < valid.size(); n++) {
+		bytes.assign(valid.begin(), valid.begin() + n);
+		CHECK(rejected(bytes));
+	}
+	// a file of the right size, whose string says it is longer than the whole document
+	const string path = "validateCorpus.bson";
+	vector<char> broken = valid;
+	size_t text = search(broken.begin(), broken.end(), "text", "text" + 5) - broken.begin();
+	int32_t huge = 0x7fffffff;
+	memcpy(&broken[text + 5], &huge, 4);
+	for (int loader = 0; loader < 3; loader++) {
+		CHECK(b.save(path));
+		CHECK(loadsFile(path, loader));
+		ofstream out(path, ios::binary | ios::trunc);
+		out.write(broken.data(), broken.size());
+		out.close();
+		CHECK(!loadsFile(path, loader));
+	}
+	remove(path.c_str());
+
+	// objects nested up to the limit below the root are fine, one more is not
+	ofxBson nested;
+	for (int depth = 0; depth < _bson::BSONMaxDepth; depth++) {
+		nested.addChild("o");
+		nested.setTo("o");
+	}
+	CHECK(nested.saveTo(valid));
+	CHECK(_bson::validateBSON(valid.data(), valid.size()).isOK());
+	nested.addChild("o");
+	CHECK(nested.saveTo(valid));
+	CHECK(!_bson::validateBSON(valid.data(), valid.size()).isOK());
+	return passed();
+}